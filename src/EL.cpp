@@ -1,23 +1,184 @@
 #include "EL.h"
+#include "scheduler.h"
+#include "trace.h"
 
-EL getEL(const Eigen::Ref<const Eigen::MatrixXd>& g,
-         const int maxit,
-         const double abstol) {
+namespace {
+// J'J, with the rows split over threads when threads > 1
+Eigen::MatrixXd cross_product(const Eigen::Ref<const Eigen::MatrixXd>& J,
+                              const int threads) {
+  if (threads <= 1) {
+    return J.transpose() * J;
+  }
+  std::vector<Eigen::MatrixXd> partial(threads);
+  split_rows(J.rows(), threads, [&](const int k, const int begin, const int end) {
+    partial[k].noalias() =
+      J.middleRows(begin, end - begin).transpose() * J.middleRows(begin, end - begin);
+  });
+  for (int k = 1; k < threads; ++k) {
+    partial[0] += partial[k];
+  }
+  return partial[0];
+}
+
+// estimating functions stored as a matrix
+struct DENSE_G {
+  const Eigen::Ref<const Eigen::MatrixXd>& g;
+  const int threads;
+
+  int rows() const {return g.rows();}
+  Eigen::VectorXd row(const int i) const {return g.row(i).transpose();}
+  Eigen::VectorXd mean() const {return g.colwise().mean().transpose();}
+  Eigen::VectorXd min() const {return g.colwise().minCoeff().transpose();}
+  Eigen::VectorXd max() const {return g.colwise().maxCoeff().transpose();}
+  Eigen::VectorXd initial_lambda() const {
+    return cross_product(g, threads).ldlt().solve(g.colwise().sum().transpose());
+  }
+  Eigen::VectorXd product(const Eigen::VectorXd& lambda) const {
+    return g * lambda;
+  }
+  // J'J and J'y with J = diag(sqrt(-d2plog)) * g, y = dplog / sqrt(-d2plog)
+  void normal_equations(const PSEUDO_LOG& log,
+                        Eigen::MatrixXd& hessian,
+                        Eigen::VectorXd& gradient) const {
+    const Eigen::MatrixXd J = g.array().colwise() * log.sqrt_neg_d2plog;
+    gradient = J.transpose() * (log.dplog / log.sqrt_neg_d2plog).matrix();
+    hessian = cross_product(J, threads);
+  }
+};
+
+// estimating functions x - 1 * theta', centered one block of rows at a time
+// so that only a block(not a copy of x) is held in memory per thread
+struct CENTERED_G {
+  const Eigen::Ref<const Eigen::MatrixXd>& x;
+  const Eigen::Ref<const Eigen::VectorXd>& theta;
+  const int threads;
+  static const int block = 256;
+
+  int rows() const {return x.rows();}
+  Eigen::VectorXd row(const int i) const {
+    return x.row(i).transpose() - theta;
+  }
+  Eigen::VectorXd mean() const {
+    return x.colwise().mean().transpose() - theta;
+  }
+  Eigen::VectorXd min() const {
+    return x.colwise().minCoeff().transpose() - theta;
+  }
+  Eigen::VectorXd max() const {
+    return x.colwise().maxCoeff().transpose() - theta;
+  }
+  Eigen::MatrixXd centered(const int i, const int size) const {
+    return x.middleRows(i, size).rowwise() - theta.transpose();
+  }
+  Eigen::VectorXd initial_lambda() const {
+    std::vector<Eigen::MatrixXd> gram(threads);
+    std::vector<Eigen::VectorXd> sum(threads);
+    split_rows(rows(), threads, [&](const int k, const int begin, const int end) {
+      gram[k] = Eigen::MatrixXd::Zero(x.cols(), x.cols());
+      sum[k] = Eigen::VectorXd::Zero(x.cols());
+      for (int i = begin; i < end; i += block) {
+        const Eigen::MatrixXd g = centered(i, std::min(block, end - i));
+        gram[k].selfadjointView<Eigen::Lower>().rankUpdate(g.transpose());
+        sum[k] += g.colwise().sum().transpose();
+      }
+    });
+    for (int k = 1; k < threads; ++k) {
+      gram[0] += gram[k];
+      sum[0] += sum[k];
+    }
+    return gram[0].selfadjointView<Eigen::Lower>().ldlt().solve(sum[0]);
+  }
+  Eigen::VectorXd product(const Eigen::VectorXd& lambda) const {
+    Eigen::VectorXd out(x.rows());
+    split_rows(rows(), threads, [&](const int, const int begin, const int end) {
+      for (int i = begin; i < end; i += block) {
+        const int size = std::min(block, end - i);
+        out.segment(i, size) = centered(i, size) * lambda;
+      }
+    });
+    return out;
+  }
+  void normal_equations(const PSEUDO_LOG& log,
+                        Eigen::MatrixXd& hessian,
+                        Eigen::VectorXd& gradient) const {
+    std::vector<Eigen::MatrixXd> partial_hessian(threads);
+    std::vector<Eigen::VectorXd> partial_gradient(threads);
+    split_rows(rows(), threads, [&](const int k, const int begin, const int end) {
+      partial_hessian[k] = Eigen::MatrixXd::Zero(x.cols(), x.cols());
+      partial_gradient[k] = Eigen::VectorXd::Zero(x.cols());
+      for (int i = begin; i < end; i += block) {
+        const int size = std::min(block, end - i);
+        const Eigen::MatrixXd J = centered(i, size).array().colwise() *
+          log.sqrt_neg_d2plog.segment(i, size);
+        partial_gradient[k] += J.transpose() *
+          (log.dplog.segment(i, size) / log.sqrt_neg_d2plog.segment(i, size))
+          .matrix();
+        partial_hessian[k].selfadjointView<Eigen::Lower>()
+          .rankUpdate(J.transpose());
+      }
+    });
+    for (int k = 1; k < threads; ++k) {
+      partial_hessian[0] += partial_hessian[k];
+      partial_gradient[0] += partial_gradient[k];
+    }
+    hessian = std::move(partial_hessian[0]);
+    gradient = std::move(partial_gradient[0]);
+    hessian.triangularView<Eigen::StrictlyUpper>() = hessian.transpose();
+  }
+};
+
+template <typename G>
+bool separated(const G& g, const int maxit) {
+  // 0 outside the coordinate ranges
+  if ((g.min().array() >= 0).any() || (g.max().array() <= 0).any()) {
+    return true;
+  }
+  // Gilbert's algorithm for the point z of the convex hull nearest to 0,
+  // starting from the mean. An iterate with g_i'z > 0 for all i separates 0
+  // from the hull; if 0 is inside, z only shrinks and the search gives up.
+  Eigen::VectorXd z = g.mean();
+  for (int k = 0; k < maxit; ++k) {
+    int i;
+    if (g.product(z).minCoeff(&i) > 0) {
+      return true;
+    }
+    // line search on the segment from z to the most violating row
+    const Eigen::VectorXd d = g.row(i) - z;
+    const double dd = d.squaredNorm();
+    if (dd == 0) {
+      break;
+    }
+    z += std::min(1.0, std::max(0.0, -z.dot(d) / dd)) * d;
+  }
+  return false;
+}
+
+template <typename G>
+EL newton_EL(const G& g,
+             Eigen::VectorXd lambda,
+             const int maxit,
+             const double abstol,
+             const bool derivatives) {
+  TRACE_SPAN span("lambda");
   // maximization
   // Eigen::VectorXd lambda = Eigen::VectorXd::Zero(g.cols());
-  Eigen::VectorXd lambda = (g.transpose() * g).ldlt().solve(g.colwise().sum());
-  double f1;
+  // plog class at the current lambda; each accepted proposal below becomes
+  // the state for the next iteration
+  PSEUDO_LOG log_tmp(Eigen::VectorXd::Ones(g.rows()) + g.product(lambda));
+  double f1 = log_tmp.plog_sum;
+  // gradient & hessian of the Newton system at log_tmp, built once per
+  // accepted state: for the next step or, after the last, for derivatives
+  Eigen::VectorXd gradient;
+  Eigen::MatrixXd hessian;
+  if (maxit != 0 || derivatives) {
+    g.normal_equations(log_tmp, hessian, gradient);
+  }
   int iterations = 0;
   bool convergence = false;
   while (!convergence && iterations != maxit) {
-    // plog class
-    PSEUDO_LOG log_tmp(Eigen::VectorXd::Ones(g.rows()) + g * lambda);
-
     // // function evaluation
     // const double f0 = log_tmp.plog_sum;
-
-    // J matrix
-    const Eigen::MatrixXd J = g.array().colwise() * log_tmp.sqrt_neg_d2plog;
+    const double f0 = f1;
 
     // // J matrix & y vector
     // Eigen::ArrayXd v1 = log_tmp.sqrt_neg_d2plog;
@@ -26,24 +187,25 @@ EL getEL(const Eigen::Ref<const Eigen::MatrixXd>& g,
     /// Eigen::VectorXd y = v2 / v1;
 
     // prpose new lambda by NR method with least square
-    Eigen::VectorXd&& step =
-      (J.transpose() * J).ldlt().solve(
-          J.transpose() * (log_tmp.dplog / log_tmp.sqrt_neg_d2plog).matrix());
+    Eigen::VectorXd&& step = hessian.ldlt().solve(gradient);
 
     // update function value
-    f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g.rows()) + g * (lambda + step));
+    PSEUDO_LOG log_new(Eigen::VectorXd::Ones(g.rows()) + g.product(lambda + step));
 
-    // step halving to ensure validity
-    while (f1 < log_tmp.plog_sum) {
+    // step halving to ensure validity; decreases within the rounding level
+    // of the sums are noise
+    while (f0 - log_new.plog_sum > PSEUDO_LOG::resolution(log_new.plog_scale)) {
       step /= 2;
-      f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g.rows()) + g * (lambda + step));
+      log_new = PSEUDO_LOG(Eigen::VectorXd::Ones(g.rows()) + g.product(lambda + step));
     }
 
     // update lambda
     lambda += step;
+    log_tmp = std::move(log_new);
+    f1 = log_tmp.plog_sum;
 
     // convergence check
-    if (f1 - log_tmp.plog_sum < abstol) {
+    if (f1 - f0 < PSEUDO_LOG::tolerance(abstol, log_tmp.plog_scale)) {
       // Eigen::ArrayXd v1 = log_tmp.sqrt_neg_d2plog;
       // Eigen::ArrayXd v2 = log_tmp.dplog;
       // Eigen::MatrixXd J = g.array().colwise() * v1;
@@ -52,16 +214,226 @@ EL getEL(const Eigen::Ref<const Eigen::MatrixXd>& g,
     } else {
       ++iterations;
     }
+    if ((!convergence && iterations != maxit) || derivatives) {
+      g.normal_equations(log_tmp, hessian, gradient);
+    }
+  }
+
+  if (!derivatives) {
+    return {lambda, f1, iterations, convergence, {}, {}, {}};
+  }
+  // weights and derivatives of -logLR from the final plog state(weights
+  // 1 / (n * (1 + lambda'g)) inside the convex hull)
+  return {lambda, f1, iterations, convergence,
+          log_tmp.dplog / static_cast<double>(g.rows()),
+          -gradient, hessian};
+}
+
+template <typename G>
+EL trust_region_EL(const G& g,
+                   Eigen::VectorXd lambda,
+                   const int maxit,
+                   const double abstol,
+                   const bool derivatives) {
+  TRACE_SPAN span("lambda");
+  PSEUDO_LOG log_tmp(Eigen::VectorXd::Ones(g.rows()) + g.product(lambda));
+  double f1 = log_tmp.plog_sum;
+  Eigen::VectorXd gradient;
+  Eigen::MatrixXd hessian;
+  g.normal_equations(log_tmp, hessian, gradient);
+  // Marquardt damping: the diagonal of the hessian is scaled by 1 + mu, with
+  // mu updated by Nielsen's rule; 0 gives the full Newton step
+  double mu = 0;
+  double nu = 2;
+  int iterations = 0;
+  bool convergence = false;
+  while (true) {
+    const Eigen::VectorXd newton = hessian.ldlt().solve(gradient);
+    // Newton decrement: half the squared gradient norm in the metric of the
+    // hessian, the predicted increase of the full Newton step
+    if (gradient.dot(newton) / 2 <
+          PSEUDO_LOG::tolerance(abstol, log_tmp.plog_scale)) {
+      convergence = true;
+      break;
+    }
+    if (iterations == maxit) {
+      break;
+    }
+    ++iterations;
+    // shrink the region until a step increases the objective
+    bool accepted = false;
+    while (mu < 1e12) {
+      Eigen::VectorXd step;
+      if (mu == 0) {
+        step = newton;
+      } else {
+        Eigen::MatrixXd damped = hessian;
+        damped.diagonal() *= 1 + mu;
+        step = damped.ldlt().solve(gradient);
+      }
+      PSEUDO_LOG log_new(Eigen::VectorXd::Ones(g.rows()) + g.product(lambda + step));
+      const double actual = log_new.plog_sum - f1;
+      if (actual > 0) {
+        // agreement with the quadratic model decides the next region
+        const double rho =
+          actual / (step.dot(gradient) - 0.5 * step.dot(hessian * step));
+        mu *= std::max(1.0 / 3, 1 - std::pow(2 * rho - 1, 3));
+        if (mu < 1e-6) {
+          mu = 0;
+        }
+        nu = 2;
+        lambda += step;
+        log_tmp = std::move(log_new);
+        f1 = log_tmp.plog_sum;
+        accepted = true;
+        break;
+      }
+      mu = mu == 0 ? 1 : mu * nu;
+      nu *= 2;
+    }
+    if (!accepted) {
+      break;
+    }
+    g.normal_equations(log_tmp, hessian, gradient);
+  }
+
+  if (!derivatives) {
+    return {lambda, f1, iterations, convergence, {}, {}, {}};
+  }
+  return {lambda, f1, iterations, convergence,
+          log_tmp.dplog / static_cast<double>(g.rows()),
+          -gradient, hessian};
+}
+
+template <typename G>
+EL solve_EL(const G& g,
+            Eigen::VectorXd lambda,
+            const int maxit,
+            const double abstol,
+            const bool derivatives) {
+  return el_method() == TRUST_REGION ?
+    trust_region_EL(g, std::move(lambda), maxit, abstol, derivatives) :
+    newton_EL(g, std::move(lambda), maxit, abstol, derivatives);
+}
+}
+
+EL_SOLVER::EL_SOLVER(const std::string& solver) : previous(el_method()) {
+  if (solver == "trust") {
+    el_method() = TRUST_REGION;
+  } else if (solver == "joint") {
+    el_method() = JOINT;
+  } else {
+    if (solver != "newton") {
+      native::warning("solver '%s' is not supported. Using 'newton' as default.",
+                    solver);
+    }
+    el_method() = NEWTON;
+  }
+}
+
+EL getEL(const Eigen::Ref<const Eigen::MatrixXd>& g,
+         const int maxit,
+         const double abstol,
+         const bool derivatives) {
+  const DENSE_G G{g, solve_threads(g.rows(), g.cols())};
+  return solve_EL(G, G.initial_lambda(), maxit, abstol, derivatives);
+}
+
+EL refine_EL(const Eigen::Ref<const Eigen::MatrixXd>& g,
+             const Eigen::Ref<const Eigen::VectorXd>& lambda0,
+             const int maxit,
+             const double abstol) {
+  return solve_EL(DENSE_G{g, solve_threads(g.rows(), g.cols())}, lambda0,
+                  maxit, abstol, false);
+}
+
+double lambda_decrement(const Eigen::Ref<const Eigen::MatrixXd>& g,
+                        const Eigen::Ref<const Eigen::VectorXd>& lambda) {
+  const DENSE_G G{g, solve_threads(g.rows(), g.cols())};
+  const PSEUDO_LOG log(Eigen::VectorXd::Ones(g.rows()) + G.product(lambda));
+  Eigen::MatrixXd hessian;
+  Eigen::VectorXd gradient;
+  G.normal_equations(log, hessian, gradient);
+  return gradient.dot(hessian.ldlt().solve(gradient)) / 2;
+}
+
+bool hull_separated(const Eigen::Ref<const Eigen::MatrixXd>& g,
+                    const int maxit) {
+  return separated(DENSE_G{g, 1}, maxit);
+}
+
+bool hull_separated(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                    const Eigen::Ref<const Eigen::VectorXd>& theta,
+                    const int maxit) {
+  return separated(CENTERED_G{x, theta, solve_threads(x.rows(), x.cols())},
+                   maxit);
+}
+
+EL getEL(const Eigen::Ref<const Eigen::MatrixXd>& x,
+         const Eigen::Ref<const Eigen::VectorXd>& theta,
+         const int maxit,
+         const double abstol,
+         const bool derivatives) {
+  const CENTERED_G G{x, theta, solve_threads(x.rows(), x.cols())};
+  return solve_EL(G, G.initial_lambda(), maxit, abstol, derivatives);
+}
+
+EL mean_EL(const Eigen::Ref<const Eigen::MatrixXd>& x,
+           const Eigen::Ref<const Eigen::VectorXd>& theta,
+           const int maxit,
+           const double abstol,
+           const bool derivatives) {
+  const CENTERED_G G{x, theta, solve_threads(x.rows(), x.cols())};
+  const Eigen::VectorXd lambda = G.initial_lambda();
+  // the hull check costs up to 20 passes over the data, so it is left to
+  // starts below the pseudo log threshold and to failed solves
+  const bool suspect =
+    G.product(lambda).minCoeff() <= 1.0 / G.rows() - 1.0;
+  bool separated_hull = suspect && separated(G, 20);
+  EL result;
+  if (!separated_hull) {
+    result = solve_EL(G, lambda, maxit, abstol, derivatives);
+    separated_hull = !suspect && !result.convergence && separated(G, 20);
   }
+  if (separated_hull) {
+    const int n = x.rows();
+    const int p = x.cols();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    result = {Eigen::VectorXd::Zero(p),
+              std::numeric_limits<double>::infinity(), 0, false,
+              Eigen::ArrayXd::Constant(n, nan),
+              Eigen::VectorXd::Constant(p, nan),
+              Eigen::MatrixXd::Constant(p, p, nan)};
+  }
+  return result;
+}
 
-  return {lambda, f1, iterations, convergence};
+EL getEL(const Eigen::Ref<const Eigen::MatrixXd>& x,
+         const Eigen::Ref<const Eigen::VectorXd>& theta,
+         const Eigen::Ref<const Eigen::VectorXd>& lambda0,
+         const int maxit,
+         const double abstol) {
+  return solve_EL(CENTERED_G{x, theta, solve_threads(x.rows(), x.cols())},
+                  lambda0, maxit, abstol, false);
 }
 
 EL2::EL2(const Eigen::Ref<const Eigen::MatrixXd>& g,
          const int maxit,
          const double abstol) {
+  const int threads = solve_threads(g.rows(), g.cols());
+  if (el_method() == TRUST_REGION) {
+    const DENSE_G G{g, threads};
+    const EL result =
+      trust_region_EL(G, G.initial_lambda(), maxit, abstol, false);
+    lambda = result.lambda;
+    nlogLR = result.nlogLR;
+    iterations = result.iterations;
+    convergence = result.convergence;
+    return;
+  }
+  TRACE_SPAN span("lambda");
   // maximization
-  lambda = (g.transpose() * g).ldlt().solve(g.colwise().sum());
+  lambda = cross_product(g, threads).ldlt().solve(g.colwise().sum().transpose());
   iterations = 0;
   convergence = false;
   while (!convergence && iterations != maxit) {
@@ -71,13 +443,14 @@ EL2::EL2(const Eigen::Ref<const Eigen::MatrixXd>& g,
     const Eigen::MatrixXd J = g.array().colwise() * log_tmp.sqrt_neg_d2plog;
     // prpose new lambda by NR method with least square
     Eigen::VectorXd step =
-      (J.transpose() * J).ldlt().solve(
+      cross_product(J, threads).ldlt().solve(
           J.transpose() * (log_tmp.dplog / log_tmp.sqrt_neg_d2plog).matrix());
     // update function value
     nlogLR =
       PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g.rows()) + g * (lambda + step));
     // step halving to ensure validity
-    while (nlogLR < log_tmp.plog_sum) {
+    while (log_tmp.plog_sum - nlogLR >
+             PSEUDO_LOG::resolution(log_tmp.plog_scale)) {
       step /= 2;
       nlogLR =
         PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g.rows()) + g * (lambda + step));
@@ -85,7 +458,8 @@ EL2::EL2(const Eigen::Ref<const Eigen::MatrixXd>& g,
     // update lambda
     lambda += step;
     // convergence check
-    if (nlogLR - log_tmp.plog_sum < abstol) {
+    if (nlogLR - log_tmp.plog_sum <
+          PSEUDO_LOG::tolerance(abstol, log_tmp.plog_scale)) {
       convergence = true;
     } else {
       ++iterations;
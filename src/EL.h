@@ -1,8 +1,7 @@
 #ifndef EL_H_
 #define EL_H_
 
-#include "eigen_config.h"
-#include <RcppEigen.h>
+#include "native.h"
 #include "PSEUDO_LOG.h"
 
 struct EL {
@@ -10,6 +9,24 @@ struct EL {
   double nlogLR;
   int iterations;
   bool convergence;
+  // filled only when requested
+  Eigen::ArrayXd w;
+  Eigen::VectorXd gradient;
+  Eigen::MatrixXd hessian;
+};
+
+inline EL_METHOD& el_method() {
+  return call_settings().method;
+}
+
+class EL_SOLVER {
+public:
+  // "newton", "trust" or "joint"
+  explicit EL_SOLVER(const std::string& solver);
+  ~EL_SOLVER() {el_method() = previous;}
+
+private:
+  const EL_METHOD previous;
 };
 
 struct minEL {
@@ -18,12 +35,56 @@ struct minEL {
   double nlogLR;
   int iterations;
   bool convergence;
+  // exact solves refreshing the approximate lambda; 0 for the other solvers
+  int refreshes;
 };
 
 EL getEL(const Eigen::Ref<const Eigen::MatrixXd>& g,
+         const int maxit = 100,
+         const double abstol = 1e-8,
+         const bool derivatives = false);
+// estimating functions g = x - 1 * theta' formed block by block
+EL getEL(const Eigen::Ref<const Eigen::MatrixXd>& x,
+         const Eigen::Ref<const Eigen::VectorXd>& theta,
+         const int maxit = 100,
+         const double abstol = 1e-8,
+         const bool derivatives = false);
+// As above, with theta outside the convex hull of x giving nlogLR = Inf,
+// iterations = 0, convergence = false and NaN weights and derivatives. The
+// hull is checked only when the least squares start leaves some
+// 1 + lambda'g_i <= 1 / n or the solver does not converge.
+EL mean_EL(const Eigen::Ref<const Eigen::MatrixXd>& x,
+           const Eigen::Ref<const Eigen::VectorXd>& theta,
+           const int maxit = 100,
+           const double abstol = 1e-8,
+           const bool derivatives = false);
+// Newton iterations started from lambda0 instead of the least squares value
+EL getEL(const Eigen::Ref<const Eigen::MatrixXd>& x,
+         const Eigen::Ref<const Eigen::VectorXd>& theta,
+         const Eigen::Ref<const Eigen::VectorXd>& lambda0,
          const int maxit = 100,
          const double abstol = 1e-8);
 
+// Newton iterations on g started from lambda0, e.g. an approximate solution
+EL refine_EL(const Eigen::Ref<const Eigen::MatrixXd>& g,
+             const Eigen::Ref<const Eigen::VectorXd>& lambda0,
+             const int maxit = 100,
+             const double abstol = 1e-8);
+// Newton decrement of the first-order condition in lambda, half the squared
+// norm of the gradient in the metric of the inverse Hessian: to second order
+// the amount by which sum(plog(1 + g * lambda)) falls short of its maximum
+double lambda_decrement(const Eigen::Ref<const Eigen::MatrixXd>& g,
+                        const Eigen::Ref<const Eigen::VectorXd>& lambda);
+
+// Cheap feasibility check run before the solvers. True if 0 is shown to lie
+// outside the convex hull of the rows of g(then -logLR is infinite); false
+// if no separating direction was found within maxit steps.
+bool hull_separated(const Eigen::Ref<const Eigen::MatrixXd>& g,
+                    const int maxit = 20);
+bool hull_separated(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                    const Eigen::Ref<const Eigen::VectorXd>& theta,
+                    const int maxit = 20);
+
 class EL2 {
 public:
   Eigen::VectorXd lambda;
@@ -0,0 +1,289 @@
+#include "EL_BATCH.h"
+#include "trace.h"
+
+namespace {
+// column sums of the pseudo log of z(n x k) and of its absolute terms, as in
+// PSEUDO_LOG::sum
+Eigen::ArrayXd plog_sums(const Eigen::ArrayXXd& z, Eigen::ArrayXd& scale) {
+  const double n = static_cast<double>(z.rows());
+  const double a1 = -std::log(n) - 1.5;
+  const double a2 = 2.0 * n;
+  const double a3 = -0.5 * n * n;
+  const Eigen::ArrayXXd terms =
+    (n * z < 1.0).select(a1 + a2 * z + a3 * z.square(), z.log());
+  scale = terms.abs().colwise().sum().transpose();
+  Eigen::ArrayXd out(z.cols());
+  for (int k = 0; k < z.cols(); ++k) {
+    out(k) = compensated_sum(terms.col(k));
+  }
+  return out;
+}
+
+// dplog and sqrt(-d2plog) of each entry of z(n x k), as in PSEUDO_LOG
+void plog_derivatives(const Eigen::ArrayXXd& z,
+                      Eigen::ArrayXXd& dplog,
+                      Eigen::ArrayXXd& sqrt_neg_d2plog) {
+  const double n = static_cast<double>(z.rows());
+  const double a2 = 2.0 * n;
+  const double a3 = -0.5 * n * n;
+  dplog = (n * z < 1.0).select(a2 + 2 * a3 * z, z.inverse());
+  sqrt_neg_d2plog = (n * z < 1.0).select(Eigen::ArrayXXd::Constant(
+    z.rows(), z.cols(), a2 / 2), z.inverse());
+}
+}
+
+EL_BACKEND::EL_BACKEND(const std::string& backend)
+  : previous(el_execution()) {
+  if (backend == "batch") {
+    el_execution() = BATCH;
+  } else {
+    if (backend != "scalar") {
+      native::warning("backend '%s' is not supported. Using 'scalar' as default.",
+                    backend);
+    }
+    el_execution() = SCALAR;
+  }
+}
+
+EL_BATCH::EL_BATCH(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                   const Eigen::Ref<const Eigen::MatrixXd>& c,
+                   const int maxit,
+                   const double abstol,
+                   const int width)
+  : x(x), c(c), maxit(maxit), abstol(abstol), width(std::max(width, 1)),
+    range(theta_range_ibd(x, c)), gamma0(1.0 / col_sums(c).mean()),
+    phase(this->width, EMPTY), hypothesis(this->width, -1),
+    theta(Eigen::MatrixXd::Zero(x.cols(), this->width)),
+    lambda(Eigen::MatrixXd::Zero(x.cols(), this->width)),
+    gamma(Eigen::ArrayXd::Zero(this->width)),
+    f0(Eigen::ArrayXd::Zero(this->width)),
+    f1(Eigen::ArrayXd::Zero(this->width)),
+    scale1(Eigen::ArrayXd::Zero(this->width)),
+    iterations(Eigen::ArrayXi::Zero(this->width)),
+    theta_tmp(Eigen::MatrixXd::Zero(x.cols(), this->width)),
+    lambda_tmp(Eigen::MatrixXd::Zero(x.cols(), this->width)),
+    f_tmp(Eigen::ArrayXd::Zero(this->width)),
+    scale_tmp(Eigen::ArrayXd::Zero(this->width)),
+    solved(this->width, 0) {}
+
+Eigen::ArrayXXd EL_BATCH::z(const Eigen::MatrixXd& theta,
+                            const Eigen::MatrixXd& lambda) const {
+  // (x - c * diag(theta_k)) * lambda_k = x * lambda_k - c * (theta_k o lambda_k)
+  return (x * lambda - c * theta.cwiseProduct(lambda)).array() + 1;
+}
+
+void EL_BATCH::solve_lambda() {
+  TRACE_SPAN span("lambda");
+  const int p = x.cols();
+  // lanes in use, each with its estimating functions at theta_tmp
+  std::vector<int> lanes;
+  Eigen::MatrixXd g(x.rows(), p * width);
+  for (int k = 0; k < width; ++k) {
+    if (phase[k] == EMPTY) {
+      continue;
+    }
+    lanes.push_back(k);
+    solved[k] = 0;
+    g.middleCols(p * k, p) = g_ibd(theta_tmp.col(k), x, c);
+    const Eigen::Ref<const Eigen::MatrixXd> g_k = g.middleCols(p * k, p);
+    lambda_tmp.col(k) = (g_k.transpose() * g_k).ldlt().solve(
+      g_k.colwise().sum().transpose());
+  }
+
+  // EL2 for every lane in lockstep: Newton steps, halved until the pseudo
+  // log increases. Only the columns of unfinished lanes are evaluated.
+  Eigen::ArrayXi inner = Eigen::ArrayXi::Zero(width);
+  Eigen::ArrayXXd dplog, sqrt_neg_d2plog;
+  while (!lanes.empty()) {
+    const int a = lanes.size();
+    Eigen::MatrixXd theta_a(p, a);
+    Eigen::MatrixXd lambda_a(p, a);
+    for (int i = 0; i < a; ++i) {
+      theta_a.col(i) = theta_tmp.col(lanes[i]);
+      lambda_a.col(i) = lambda_tmp.col(lanes[i]);
+    }
+    const Eigen::ArrayXXd z0 = z(theta_a, lambda_a);
+    Eigen::ArrayXd scale;
+    const Eigen::ArrayXd f = plog_sums(z0, scale);
+    plog_derivatives(z0, dplog, sqrt_neg_d2plog);
+    Eigen::MatrixXd step(p, a);
+    for (int i = 0; i < a; ++i) {
+      const Eigen::MatrixXd J = g.middleCols(p * lanes[i], p).array().colwise() *
+        sqrt_neg_d2plog.col(i);
+      step.col(i) = (J.transpose() * J).ldlt().solve(
+        J.transpose() * (dplog.col(i) / sqrt_neg_d2plog.col(i)).matrix());
+    }
+    Eigen::ArrayXd scale_trial;
+    Eigen::ArrayXd f_trial = plog_sums(z(theta_a, lambda_a + step), scale_trial);
+    std::vector<int> halving;
+    for (int i = 0; i < a; ++i) {
+      if (f(i) - f_trial(i) > PSEUDO_LOG::resolution(scale_trial(i))) {
+        halving.push_back(i);
+      }
+    }
+    while (!halving.empty()) {
+      const int h = halving.size();
+      Eigen::MatrixXd theta_h(p, h);
+      Eigen::MatrixXd lambda_h(p, h);
+      for (int i = 0; i < h; ++i) {
+        step.col(halving[i]) /= 2;
+        theta_h.col(i) = theta_a.col(halving[i]);
+        lambda_h.col(i) = lambda_a.col(halving[i]) + step.col(halving[i]);
+      }
+      Eigen::ArrayXd scale_h;
+      const Eigen::ArrayXd f_h = plog_sums(z(theta_h, lambda_h), scale_h);
+      std::vector<int> still;
+      for (int i = 0; i < h; ++i) {
+        f_trial(halving[i]) = f_h(i);
+        scale_trial(halving[i]) = scale_h(i);
+        if (f(halving[i]) - f_h(i) > PSEUDO_LOG::resolution(scale_h(i))) {
+          still.push_back(halving[i]);
+        }
+      }
+      halving = std::move(still);
+    }
+    // lanes retire from the lockstep once converged
+    std::vector<int> unfinished;
+    for (int i = 0; i < a; ++i) {
+      const int k = lanes[i];
+      lambda_tmp.col(k) = lambda_a.col(i) + step.col(i);
+      f_tmp(k) = f_trial(i);
+      scale_tmp(k) = scale_trial(i);
+      if (f_trial(i) - f(i) < PSEUDO_LOG::tolerance(abstol, scale(i))) {
+        solved[k] = 1;
+      } else if (++inner(k) != 100) {
+        unfinished.push_back(k);
+      }
+    }
+    lanes = std::move(unfinished);
+  }
+}
+
+void EL_BATCH::propose(const int k,
+                       const Eigen::MatrixXd& lhs,
+                       const Eigen::VectorXd& rhs) {
+  // gradient descent step on theta with lambda fixed, then projection
+  const Eigen::VectorXd z_k = (x * lambda.col(k) -
+    c * theta.col(k).cwiseProduct(lambda.col(k))).array() + 1;
+  theta_tmp.col(k) = theta.col(k) + gamma(k) *
+    (c.transpose() * PSEUDO_LOG::dp(Eigen::VectorXd(z_k)).matrix())
+    .cwiseProduct(lambda.col(k));
+  linear_projection_void(theta_tmp.col(k), lhs, rhs);
+}
+
+void EL_BATCH::run(const std::vector<Eigen::MatrixXd>& lhs,
+                   const std::vector<Eigen::VectorXd>& rhs,
+                   const Eigen::Ref<const Eigen::VectorXd>& theta0,
+                   const std::function<int()>& next,
+                   const std::function<double()>& bound,
+                   const std::function<void(int, const minEL&)>& done) {
+  const auto retire = [&](const int k, const Eigen::VectorXd& lambda_k,
+                          const bool convergence) {
+    done(hypothesis[k],
+         {theta.col(k), lambda_k, f1(k), iterations(k), convergence, 0});
+    phase[k] = EMPTY;
+  };
+  const auto propose_next = [&](const int k) {
+    propose(k, lhs[hypothesis[k]], rhs[hypothesis[k]]);
+  };
+  // accepted proposal: convergence check of test_ibd_EL
+  const auto accept = [&](const int k) {
+    theta.col(k) = theta_tmp.col(k);
+    lambda.col(k) = lambda_tmp.col(k);
+    if (f0(k) - f1(k) < PSEUDO_LOG::tolerance(abstol, scale1(k)) &&
+        iterations(k) > 0) {
+      retire(k, lambda.col(k), true);
+      return;
+    }
+    ++iterations(k);
+    if ((solved[k] && f1(k) <= bound()) || iterations(k) == maxit) {
+      retire(k, lambda.col(k), false);
+      return;
+    }
+    propose_next(k);
+    phase[k] = PROPOSAL;
+  };
+
+  bool exhausted = false;
+  while (true) {
+    // refill empty lanes from the queue
+    for (int k = 0; k < width; ++k) {
+      while (phase[k] == EMPTY && !exhausted) {
+        const int j = next();
+        if (j < 0) {
+          exhausted = true;
+          break;
+        }
+        hypothesis[k] = j;
+        theta.col(k) = linear_projection(theta0, lhs[j], rhs[j]);
+        // no theta satisfying the constraint has 0 inside the convex hull
+        if (range_separated(range, lhs[j], rhs[j])) {
+          done(j, {theta.col(k), Eigen::VectorXd::Zero(x.cols()),
+                   std::numeric_limits<double>::infinity(), 0, false, 0});
+          continue;
+        }
+        theta_tmp.col(k) = theta.col(k);
+        iterations(k) = 0;
+        phase[k] = INITIAL;
+      }
+    }
+    if (std::all_of(phase.begin(), phase.end(),
+                    [](const PHASE s) {return s == EMPTY;})) {
+      break;
+    }
+
+    solve_lambda();
+
+    // advance each lane by one step of test_ibd_EL
+    for (int k = 0; k < width; ++k) {
+      switch (phase[k]) {
+      case EMPTY:
+        break;
+      case INITIAL:
+        lambda.col(k) = lambda_tmp.col(k);
+        f1(k) = f_tmp(k);
+        scale1(k) = scale_tmp(k);
+        if ((solved[k] && f1(k) <= bound()) || maxit == 0) {
+          retire(k, lambda.col(k), false);
+          break;
+        }
+        gamma(k) = gamma0;
+        propose_next(k);
+        phase[k] = PROPOSAL;
+        break;
+      case PROPOSAL:
+        if (!solved[k] && iterations(k) > 9) {
+          el_warning("Convex hull constraint not satisfied during optimization. Optimization halted.");
+          retire(k, lambda_tmp.col(k), false);
+          break;
+        }
+        f0(k) = f1(k);
+        f1(k) = f_tmp(k);
+        scale1(k) = scale_tmp(k);
+        if (f1(k) - f0(k) > PSEUDO_LOG::resolution(scale1(k))) {
+          gamma(k) /= 2;
+          propose_next(k);
+          phase[k] = HALVING;
+          break;
+        }
+        accept(k);
+        break;
+      case HALVING:
+        if (gamma(k) < abstol) {
+          el_warning("Convex hull constraint not satisfied during step halving.");
+          accept(k);
+          break;
+        }
+        f1(k) = f_tmp(k);
+        scale1(k) = scale_tmp(k);
+        if (f1(k) - f0(k) > PSEUDO_LOG::resolution(scale1(k))) {
+          gamma(k) /= 2;
+          propose_next(k);
+          break;
+        }
+        accept(k);
+        break;
+      }
+    }
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef EL_BATCH_H_
+#define EL_BATCH_H_
+
+#include "utils_ibd.h"
+#include <functional>
+
+inline EL_EXECUTION& el_execution() {
+  return call_settings().execution;
+}
+
+inline bool batch_execution() {
+  return el_execution() == BATCH && el_method() == NEWTON;
+}
+
+class EL_BACKEND {
+public:
+  // "scalar" or "batch"
+  explicit EL_BACKEND(const std::string& backend);
+  ~EL_BACKEND() {el_execution() = previous;}
+
+private:
+  const EL_EXECUTION previous;
+};
+
+// test_ibd_EL for hypotheses lhs[j] * theta = rhs[j] on the same dense data,
+// width of them at a time. The state of each lane(theta, lambda, step size,
+// phase of the projected gradient descent) is held in structure-of-arrays
+// form, p x width matrices and width-vectors. All lanes advance together:
+// each round solves lambda for every lane in lockstep, with 1 + g * lambda
+// for all lanes formed by two matrix products, the pseudo log evaluated on
+// the n x width array and convergence tracked by masks. Lanes that finish
+// retire and are refilled from the queue of hypotheses. The iterations are
+// those of test_ibd_EL and EL2, so results agree up to rounding.
+class EL_BATCH {
+public:
+  EL_BATCH(const Eigen::Ref<const Eigen::MatrixXd>& x,
+           const Eigen::Ref<const Eigen::MatrixXd>& c,
+           const int maxit = 1000,
+           const double abstol = 1e-8,
+           const int width = 8);
+
+  // Solves the hypotheses returned by next() until it returns -1, starting
+  // from the projection of theta0. A lane whose -logLR is known to be at most
+  // bound() is stopped early, as test_ibd_EL does with bound. done(j, result)
+  // receives each retired hypothesis.
+  void run(const std::vector<Eigen::MatrixXd>& lhs,
+           const std::vector<Eigen::VectorXd>& rhs,
+           const Eigen::Ref<const Eigen::VectorXd>& theta0,
+           const std::function<int()>& next,
+           const std::function<double()>& bound,
+           const std::function<void(int, const minEL&)>& done);
+
+private:
+  enum PHASE {EMPTY, INITIAL, PROPOSAL, HALVING};
+
+  const Eigen::Ref<const Eigen::MatrixXd> x;
+  const Eigen::Ref<const Eigen::MatrixXd> c;
+  const int maxit;
+  const double abstol;
+  const int width;
+  const Eigen::MatrixXd range;
+  const double gamma0;
+  // lanes
+  std::vector<PHASE> phase;
+  std::vector<int> hypothesis;
+  Eigen::MatrixXd theta;
+  Eigen::MatrixXd lambda;
+  Eigen::ArrayXd gamma;
+  Eigen::ArrayXd f0;
+  Eigen::ArrayXd f1;
+  // sums of the absolute pseudo log terms of f1 and f_tmp
+  Eigen::ArrayXd scale1;
+  Eigen::ArrayXi iterations;
+  // proposals and their solved lambda
+  Eigen::MatrixXd theta_tmp;
+  Eigen::MatrixXd lambda_tmp;
+  Eigen::ArrayXd f_tmp;
+  Eigen::ArrayXd scale_tmp;
+  std::vector<char> solved;
+
+  // 1 + g(theta_k) * lambda_k for all lanes k
+  Eigen::ArrayXXd z(const Eigen::MatrixXd& theta,
+                    const Eigen::MatrixXd& lambda) const;
+  void solve_lambda();
+  void propose(const int k, const Eigen::MatrixXd& lhs,
+               const Eigen::VectorXd& rhs);
+};
+#endif
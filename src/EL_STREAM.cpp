@@ -0,0 +1,120 @@
+#include "EL_STREAM.h"
+
+namespace {
+// mean and centered cross products of the rows of x
+void moments(const Eigen::Ref<const Eigen::MatrixXd>& x,
+             Eigen::VectorXd& mean,
+             Eigen::MatrixXd& scatter) {
+  mean = x.colwise().mean().transpose();
+  const Eigen::MatrixXd centered = x.rowwise() - mean.transpose();
+  scatter = centered.transpose() * centered;
+}
+}
+
+EL_STREAM::EL_STREAM(const Eigen::Ref<const Eigen::VectorXd>& theta,
+                     const int window,
+                     const int maxit,
+                     const double abstol)
+  : theta(theta), window(window), maxit(maxit), abstol(abstol),
+    data(0, theta.size()), start(0), n(0),
+    mean(Eigen::VectorXd::Zero(theta.size())),
+    scatter(Eigen::MatrixXd::Zero(theta.size(), theta.size())),
+    result{Eigen::VectorXd::Zero(theta.size()),
+           std::numeric_limits<double>::infinity(), 0, false, {}, {}, {}},
+    feasible(false) {}
+
+void EL_STREAM::update(const Eigen::Ref<const Eigen::MatrixXd>& x) {
+  // rows older than the window are never used
+  const int m = window > 0 ? std::min<int>(x.rows(), window) : x.rows();
+  if (window > 0 && n + m > window) {
+    evict(n + m - window);
+  }
+  reserve(n + m);
+  data.middleRows(start + n, m) = x.bottomRows(m);
+  if (m > 0) {
+    Eigen::VectorXd mean_m;
+    Eigen::MatrixXd scatter_m;
+    moments(x.bottomRows(m), mean_m, scatter_m);
+    const Eigen::VectorXd delta = mean_m - mean;
+    mean += delta * (static_cast<double>(m) / (n + m));
+    scatter += scatter_m +
+      (static_cast<double>(n) * m / (n + m)) * delta * delta.transpose();
+  }
+  n += m;
+
+  const int p = theta.size();
+  const Eigen::Ref<const Eigen::MatrixXd> x_n = data.middleRows(start, n);
+  // Gram matrix and sum of g = x - 1 * theta'
+  const Eigen::VectorXd shift = mean - theta;
+  const Eigen::MatrixXd gram_g = scatter + n * shift * shift.transpose();
+  const Eigen::VectorXd sum_g = n * shift;
+  // appended rows only enlarge the convex hull
+  if (feasible) {
+    result = getEL(x_n, theta, result.lambda, maxit, abstol);
+    return;
+  }
+  if (Eigen::FullPivLU<Eigen::MatrixXd>(gram_g).rank() != p) {
+    result = {Eigen::VectorXd::Zero(p),
+              std::numeric_limits<double>::infinity(), 0, false, {}, {}, {}};
+    return;
+  }
+  // after an eviction, warm start from the previous lambda. A converged
+  // solution with every 1 + lambda'g_i >= 1 / n is the EL solution itself,
+  // which shows that theta is inside the hull without checking it.
+  if (std::isfinite(result.nlogLR)) {
+    result = getEL(x_n, theta, result.lambda, maxit, abstol);
+    feasible = result.convergence &&
+      (x_n * result.lambda).minCoeff() - theta.dot(result.lambda) >=
+      1.0 / n - 1.0;
+    if (feasible) {
+      return;
+    }
+  }
+  if (hull_separated(x_n, theta)) {
+    result = {Eigen::VectorXd::Zero(p),
+              std::numeric_limits<double>::infinity(), 0, false, {}, {}, {}};
+    return;
+  }
+  feasible = true;
+  result = getEL(x_n, theta, gram_g.ldlt().solve(sum_g), maxit, abstol);
+}
+
+void EL_STREAM::reserve(const int size) {
+  if (start + size <= data.rows()) {
+    return;
+  }
+  // move the rows in use to the top, or to a buffer twice the size needed
+  // so that appends copy each row a bounded number of times
+  if (2 * size <= data.rows()) {
+    data.topRows(n) = data.middleRows(start, n).eval();
+  } else {
+    Eigen::MatrixXd grown(std::max(2 * size, 64), data.cols());
+    grown.topRows(n) = data.middleRows(start, n);
+    data.swap(grown);
+  }
+  start = 0;
+}
+
+void EL_STREAM::evict(const int k) {
+  const int size = std::min(k, n);
+  if (size == 0) {
+    return;
+  }
+  const int rest = n - size;
+  if (rest == 0) {
+    mean.setZero();
+    scatter.setZero();
+  } else {
+    // the merge of update in reverse
+    Eigen::VectorXd mean_k;
+    Eigen::MatrixXd scatter_k;
+    moments(data.middleRows(start, size), mean_k, scatter_k);
+    const Eigen::VectorXd delta = mean_k - mean;
+    mean -= delta * (static_cast<double>(size) / rest);
+    scatter -= scatter_k +
+      (static_cast<double>(n) * size / rest) * delta * delta.transpose();
+  }
+  start += size;
+  n = rest;
+  feasible = false;
+}
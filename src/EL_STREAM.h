@@ -0,0 +1,48 @@
+#ifndef EL_STREAM_H_
+#define EL_STREAM_H_
+
+#include "EL.h"
+
+// Empirical likelihood for a fixed mean theta over a growing stream of
+// observations. Rows are kept in one buffer(appends copy only the new rows),
+// together with the running mean and centered cross products of x that give
+// the Gram matrix of g = x - 1 * theta' without a pass over the data. They
+// are merged and removed in batches by Chan's pairwise updates, which avoid
+// the cancellation of raw cross products when the mean is large relative to
+// the spread. Each update
+// refines lambda by Newton iterations warm started from the previous value.
+// With a window, only the last window rows are used.
+class EL_STREAM {
+public:
+  EL_STREAM(const Eigen::Ref<const Eigen::VectorXd>& theta,
+            const int window = 0,
+            const int maxit = 100,
+            const double abstol = 1e-8);
+
+  // appends rows of x, evicts rows outside the window and refines lambda
+  void update(const Eigen::Ref<const Eigen::MatrixXd>& x);
+
+  int rows() const {return n;}
+  const EL& current() const {return result;}
+
+private:
+  const Eigen::VectorXd theta;
+  const int window;
+  const int maxit;
+  const double abstol;
+  // rows [start, start + n) of data are in use
+  Eigen::MatrixXd data;
+  int start;
+  int n;
+  // sufficient statistics of the rows in use: mean and cross products of
+  // the rows centered at it
+  Eigen::VectorXd mean;
+  Eigen::MatrixXd scatter;
+  EL result;
+  // true while the hull of the rows in use is known to contain theta
+  bool feasible;
+
+  void reserve(const int size);
+  void evict(const int k);
+};
+#endif
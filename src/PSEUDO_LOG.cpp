@@ -1,5 +1,34 @@
 #include "PSEUDO_LOG.h"
 
+void COMPENSATED_SUM::add(const int lane, const double x) {
+  const double t = sum[lane] + x;
+  compensation[lane] += std::abs(sum[lane]) >= std::abs(x) ?
+    (sum[lane] - t) + x : (x - t) + sum[lane];
+  sum[lane] = t;
+  scale[lane] += std::abs(x);
+}
+
+double COMPENSATED_SUM::value() const {
+  COMPENSATED_SUM total;
+  for (int l = 0; l < 4; ++l) {
+    total.add(0, sum[l]);
+  }
+  return total.sum[0] + total.compensation[0] +
+    compensation[0] + compensation[1] + compensation[2] + compensation[3];
+}
+
+double COMPENSATED_SUM::absolute() const {
+  return scale[0] + scale[1] + scale[2] + scale[3];
+}
+
+double compensated_sum(const Eigen::Ref<const Eigen::ArrayXd>& x) {
+  COMPENSATED_SUM out;
+  for (Eigen::Index i = 0; i < x.size(); ++i) {
+    out.add(i & 3, x[i]);
+  }
+  return out.value();
+}
+
 PSEUDO_LOG::PSEUDO_LOG(Eigen::VectorXd&& x) {
   const double n = static_cast<double>(x.size());
   const double a1 = -std::log(n) - 1.5;
@@ -8,32 +37,47 @@ PSEUDO_LOG::PSEUDO_LOG(Eigen::VectorXd&& x) {
 
   dplog.resize(x.size());
   sqrt_neg_d2plog.resize(x.size());
-  plog_sum = 0;
+  COMPENSATED_SUM sum;
 
   for (unsigned int i = 0; i < x.size(); ++i) {
     if (n * x[i] < 1.0) {
       dplog[i] = a2 + 2 * a3 * x[i];
       sqrt_neg_d2plog[i] = a2 / 2;
-      plog_sum += a1 + a2 * x[i] + a3 * x[i] * x[i];
+      sum.add(i & 3, a1 + a2 * x[i] + a3 * x[i] * x[i]);
     } else {
       dplog[i] = 1.0 / x[i];
       sqrt_neg_d2plog[i] = 1.0 / x[i];
-      plog_sum += std::log(x[i]);
+      sum.add(i & 3, std::log(x[i]));
     }
   }
+  plog_sum = sum.value();
+  plog_scale = sum.absolute();
 }
 
-double PSEUDO_LOG::sum(Eigen::VectorXd&& x) {
+namespace {
+COMPENSATED_SUM plog_terms(const Eigen::VectorXd& x) {
   const double n = static_cast<double>(x.size());
   const double a1 = -std::log(n) - 1.5;
   const double a2 = 2.0 * n;
   const double a3 = -0.5 * n * n;
-  double out = 0;
+  COMPENSATED_SUM out;
   for (unsigned int i = 0; i < x.size(); ++i) {
-    out += n * x[i] < 1.0 ? a1 + a2 * x[i] + a3 * x[i] * x[i] : std::log(x[i]);
+    out.add(i & 3, n * x[i] < 1.0 ? a1 + a2 * x[i] + a3 * x[i] * x[i] :
+              std::log(x[i]));
   }
   return out;
 }
+}
+
+double PSEUDO_LOG::sum(Eigen::VectorXd&& x) {
+  return plog_terms(x).value();
+}
+
+double PSEUDO_LOG::sum(Eigen::VectorXd&& x, double& scale) {
+  const COMPENSATED_SUM out = plog_terms(x);
+  scale = out.absolute();
+  return out.value();
+}
 
 Eigen::ArrayXd PSEUDO_LOG::dp(Eigen::VectorXd&& x) {
   const double n = static_cast<double>(x.size());
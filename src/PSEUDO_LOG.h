@@ -1,17 +1,50 @@
 #ifndef PSEUDO_LOG_H_
 #define PSEUDO_LOG_H_
 
-#include <RcppEigen.h>
+#include "native.h"
+#include <algorithm>
+#include <limits>
+
+// Neumaier's compensated summation in four independent lanes(the dependency
+// chain of one lane would serialize the loop), so the error does not grow
+// with the number of terms. Also keeps the sum of the absolute terms.
+class COMPENSATED_SUM {
+public:
+  void add(const int lane, const double x);
+  double value() const;
+  double absolute() const;
+
+private:
+  double sum[4] = {0, 0, 0, 0};
+  double compensation[4] = {0, 0, 0, 0};
+  double scale[4] = {0, 0, 0, 0};
+};
+
+double compensated_sum(const Eigen::Ref<const Eigen::ArrayXd>& x);
 
 class PSEUDO_LOG {
 public:
   Eigen::ArrayXd dplog;
   Eigen::ArrayXd sqrt_neg_d2plog;
   double plog_sum;
+  // sum of the absolute terms of plog_sum
+  double plog_scale;
 
   // PSEUDO_LOG(const Eigen::Ref<const Eigen::VectorXd>& x);
   PSEUDO_LOG(Eigen::VectorXd&& x);
   static double sum(Eigen::VectorXd&& x);
+  static double sum(Eigen::VectorXd&& x, double& scale);
   static Eigen::ArrayXd dp(Eigen::VectorXd&& x);
+
+  // Rounding level of a sum of pseudo logs whose absolute terms sum to
+  // scale. Each term carries a relative error of a few ulps that no
+  // summation removes, so differences of such sums below it are noise.
+  static double resolution(const double scale) {
+    return 4 * std::numeric_limits<double>::epsilon() * scale;
+  }
+  // abstol for differences of sums, raised to their rounding level
+  static double tolerance(const double abstol, const double scale) {
+    return std::max(abstol, resolution(scale));
+  }
 };
 #endif
@@ -6,47 +6,198 @@
 
 using namespace Rcpp;
 
+// benchmark_ibd
+Rcpp::DataFrame benchmark_ibd(const int p, const int k, const int r, const int ncores, const int B, const int reps, const int seed);
+RcppExport SEXP _elmulttest_benchmark_ibd(SEXP pSEXP, SEXP kSEXP, SEXP rSEXP, SEXP ncoresSEXP, SEXP BSEXP, SEXP repsSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const int >::type p(pSEXP);
+    Rcpp::traits::input_parameter< const int >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const int >::type r(rSEXP);
+    Rcpp::traits::input_parameter< const int >::type ncores(ncoresSEXP);
+    Rcpp::traits::input_parameter< const int >::type B(BSEXP);
+    Rcpp::traits::input_parameter< const int >::type reps(repsSEXP);
+    Rcpp::traits::input_parameter< const int >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(benchmark_ibd(p, k, r, ncores, B, reps, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
 // test_ibd
-Rcpp::List test_ibd(const Eigen::MatrixXd& x, const Eigen::MatrixXd& c, const Eigen::MatrixXd& lhs, const Eigen::VectorXd& rhs, const bool approx_lambda, const int maxit, const double abstol);
-RcppExport SEXP _elmulttest_test_ibd(SEXP xSEXP, SEXP cSEXP, SEXP lhsSEXP, SEXP rhsSEXP, SEXP approx_lambdaSEXP, SEXP maxitSEXP, SEXP abstolSEXP) {
+Rcpp::List test_ibd(SEXP x, SEXP c, const Eigen::Map<Eigen::MatrixXd>& lhs, const Eigen::Map<Eigen::VectorXd>& rhs, const bool approx_lambda, const int maxit, const double abstol, const int ncores, const std::string solver);
+RcppExport SEXP _elmulttest_test_ibd(SEXP xSEXP, SEXP cSEXP, SEXP lhsSEXP, SEXP rhsSEXP, SEXP approx_lambdaSEXP, SEXP maxitSEXP, SEXP abstolSEXP, SEXP ncoresSEXP, SEXP solverSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type x(xSEXP);
-    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type c(cSEXP);
-    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type lhs(lhsSEXP);
-    Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type rhs(rhsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type c(cSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd>& >::type lhs(lhsSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::VectorXd>& >::type rhs(rhsSEXP);
     Rcpp::traits::input_parameter< const bool >::type approx_lambda(approx_lambdaSEXP);
     Rcpp::traits::input_parameter< const int >::type maxit(maxitSEXP);
     Rcpp::traits::input_parameter< const double >::type abstol(abstolSEXP);
-    rcpp_result_gen = Rcpp::wrap(test_ibd(x, c, lhs, rhs, approx_lambda, maxit, abstol));
+    Rcpp::traits::input_parameter< const int >::type ncores(ncoresSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    rcpp_result_gen = Rcpp::wrap(test_ibd(x, c, lhs, rhs, approx_lambda, maxit, abstol, ncores, solver));
+    return rcpp_result_gen;
+END_RCPP
+}
+// test_ibd_jackknife
+Rcpp::List test_ibd_jackknife(SEXP x, SEXP c, const Eigen::Map<Eigen::MatrixXd>& lhs, const Eigen::Map<Eigen::VectorXd>& rhs, const int maxit, const double abstol, const int steps, const int ncores);
+RcppExport SEXP _elmulttest_test_ibd_jackknife(SEXP xSEXP, SEXP cSEXP, SEXP lhsSEXP, SEXP rhsSEXP, SEXP maxitSEXP, SEXP abstolSEXP, SEXP stepsSEXP, SEXP ncoresSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type c(cSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd>& >::type lhs(lhsSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::VectorXd>& >::type rhs(rhsSEXP);
+    Rcpp::traits::input_parameter< const int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const double >::type abstol(abstolSEXP);
+    Rcpp::traits::input_parameter< const int >::type steps(stepsSEXP);
+    Rcpp::traits::input_parameter< const int >::type ncores(ncoresSEXP);
+    rcpp_result_gen = Rcpp::wrap(test_ibd_jackknife(x, c, lhs, rhs, maxit, abstol, steps, ncores));
     return rcpp_result_gen;
 END_RCPP
 }
 // pairwise_ibd
-Rcpp::List pairwise_ibd(const Eigen::MatrixXd& x, const Eigen::MatrixXd& c, const bool interval, const int B, const double level, std::string method, const bool correction, const bool approx_lambda, const int ncores, const int maxit, const double abstol);
-RcppExport SEXP _elmulttest_pairwise_ibd(SEXP xSEXP, SEXP cSEXP, SEXP intervalSEXP, SEXP BSEXP, SEXP levelSEXP, SEXP methodSEXP, SEXP correctionSEXP, SEXP approx_lambdaSEXP, SEXP ncoresSEXP, SEXP maxitSEXP, SEXP abstolSEXP) {
+Rcpp::List pairwise_ibd(SEXP x, SEXP c, const bool interval, const int B, const double level, const std::string method, const bool correction, const bool approx_lambda, const int ncores, const int maxit, const double abstol, const std::string checkpoint, const bool resume, const bool screen, const double margin, const std::string trace, const std::string solver, const std::string backend, SEXP bootstrap, const bool keep_bootstrap, const std::string sampler);
+RcppExport SEXP _elmulttest_pairwise_ibd(SEXP xSEXP, SEXP cSEXP, SEXP intervalSEXP, SEXP BSEXP, SEXP levelSEXP, SEXP methodSEXP, SEXP correctionSEXP, SEXP approx_lambdaSEXP, SEXP ncoresSEXP, SEXP maxitSEXP, SEXP abstolSEXP, SEXP checkpointSEXP, SEXP resumeSEXP, SEXP screenSEXP, SEXP marginSEXP, SEXP traceSEXP, SEXP solverSEXP, SEXP backendSEXP, SEXP bootstrapSEXP, SEXP keep_bootstrapSEXP, SEXP samplerSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type x(xSEXP);
-    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type c(cSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type c(cSEXP);
     Rcpp::traits::input_parameter< const bool >::type interval(intervalSEXP);
     Rcpp::traits::input_parameter< const int >::type B(BSEXP);
     Rcpp::traits::input_parameter< const double >::type level(levelSEXP);
-    Rcpp::traits::input_parameter< std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
     Rcpp::traits::input_parameter< const bool >::type correction(correctionSEXP);
     Rcpp::traits::input_parameter< const bool >::type approx_lambda(approx_lambdaSEXP);
     Rcpp::traits::input_parameter< const int >::type ncores(ncoresSEXP);
     Rcpp::traits::input_parameter< const int >::type maxit(maxitSEXP);
     Rcpp::traits::input_parameter< const double >::type abstol(abstolSEXP);
-    rcpp_result_gen = Rcpp::wrap(pairwise_ibd(x, c, interval, B, level, method, correction, approx_lambda, ncores, maxit, abstol));
+    Rcpp::traits::input_parameter< const std::string >::type checkpoint(checkpointSEXP);
+    Rcpp::traits::input_parameter< const bool >::type resume(resumeSEXP);
+    Rcpp::traits::input_parameter< const bool >::type screen(screenSEXP);
+    Rcpp::traits::input_parameter< const double >::type margin(marginSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type trace(traceSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type backend(backendSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type bootstrap(bootstrapSEXP);
+    Rcpp::traits::input_parameter< const bool >::type keep_bootstrap(keep_bootstrapSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type sampler(samplerSEXP);
+    rcpp_result_gen = Rcpp::wrap(pairwise_ibd(x, c, interval, B, level, method, correction, approx_lambda, ncores, maxit, abstol, checkpoint, resume, screen, margin, trace, solver, backend, bootstrap, keep_bootstrap, sampler));
+    return rcpp_result_gen;
+END_RCPP
+}
+// pairwise_ibd_async
+SEXP pairwise_ibd_async(SEXP x, SEXP c, const bool interval, const int B, const double level, const bool approx_lambda, const int ncores, const int maxit, const double abstol, const std::string checkpoint, const bool resume, const bool screen, const double margin, const std::string solver, const std::string backend, const bool keep_bootstrap);
+RcppExport SEXP _elmulttest_pairwise_ibd_async(SEXP xSEXP, SEXP cSEXP, SEXP intervalSEXP, SEXP BSEXP, SEXP levelSEXP, SEXP approx_lambdaSEXP, SEXP ncoresSEXP, SEXP maxitSEXP, SEXP abstolSEXP, SEXP checkpointSEXP, SEXP resumeSEXP, SEXP screenSEXP, SEXP marginSEXP, SEXP solverSEXP, SEXP backendSEXP, SEXP keep_bootstrapSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type c(cSEXP);
+    Rcpp::traits::input_parameter< const bool >::type interval(intervalSEXP);
+    Rcpp::traits::input_parameter< const int >::type B(BSEXP);
+    Rcpp::traits::input_parameter< const double >::type level(levelSEXP);
+    Rcpp::traits::input_parameter< const bool >::type approx_lambda(approx_lambdaSEXP);
+    Rcpp::traits::input_parameter< const int >::type ncores(ncoresSEXP);
+    Rcpp::traits::input_parameter< const int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const double >::type abstol(abstolSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type checkpoint(checkpointSEXP);
+    Rcpp::traits::input_parameter< const bool >::type resume(resumeSEXP);
+    Rcpp::traits::input_parameter< const bool >::type screen(screenSEXP);
+    Rcpp::traits::input_parameter< const double >::type margin(marginSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type backend(backendSEXP);
+    Rcpp::traits::input_parameter< const bool >::type keep_bootstrap(keep_bootstrapSEXP);
+    rcpp_result_gen = Rcpp::wrap(pairwise_ibd_async(x, c, interval, B, level, approx_lambda, ncores, maxit, abstol, checkpoint, resume, screen, margin, solver, backend, keep_bootstrap));
+    return rcpp_result_gen;
+END_RCPP
+}
+// ibd_job_status
+Rcpp::List ibd_job_status(SEXP job);
+RcppExport SEXP _elmulttest_ibd_job_status(SEXP jobSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    rcpp_result_gen = Rcpp::wrap(ibd_job_status(job));
+    return rcpp_result_gen;
+END_RCPP
+}
+// ibd_job_cancel
+void ibd_job_cancel(SEXP job);
+RcppExport SEXP _elmulttest_ibd_job_cancel(SEXP jobSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    ibd_job_cancel(job);
+    return R_NilValue;
+END_RCPP
+}
+// ibd_job_collect
+Rcpp::List ibd_job_collect(SEXP job);
+RcppExport SEXP _elmulttest_ibd_job_collect(SEXP jobSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    rcpp_result_gen = Rcpp::wrap(ibd_job_collect(job));
+    return rcpp_result_gen;
+END_RCPP
+}
+// screening_report_ibd
+Rcpp::List screening_report_ibd(SEXP x, SEXP c, const int B, const double margin, const bool approx_lambda, const int ncores, const int maxit, const double abstol);
+RcppExport SEXP _elmulttest_screening_report_ibd(SEXP xSEXP, SEXP cSEXP, SEXP BSEXP, SEXP marginSEXP, SEXP approx_lambdaSEXP, SEXP ncoresSEXP, SEXP maxitSEXP, SEXP abstolSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type c(cSEXP);
+    Rcpp::traits::input_parameter< const int >::type B(BSEXP);
+    Rcpp::traits::input_parameter< const double >::type margin(marginSEXP);
+    Rcpp::traits::input_parameter< const bool >::type approx_lambda(approx_lambdaSEXP);
+    Rcpp::traits::input_parameter< const int >::type ncores(ncoresSEXP);
+    Rcpp::traits::input_parameter< const int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const double >::type abstol(abstolSEXP);
+    rcpp_result_gen = Rcpp::wrap(screening_report_ibd(x, c, B, margin, approx_lambda, ncores, maxit, abstol));
+    return rcpp_result_gen;
+END_RCPP
+}
+// multitest_ibd
+Rcpp::List multitest_ibd(SEXP x, SEXP c, SEXP hypotheses, const int B, const double level, const std::string method, const bool correction, const bool approx_lambda, const int ncores, const int maxit, const double abstol, const std::string checkpoint, const bool resume, const bool screen, const double margin, const std::string trace, const std::string solver, const std::string sampler);
+RcppExport SEXP _elmulttest_multitest_ibd(SEXP xSEXP, SEXP cSEXP, SEXP hypothesesSEXP, SEXP BSEXP, SEXP levelSEXP, SEXP methodSEXP, SEXP correctionSEXP, SEXP approx_lambdaSEXP, SEXP ncoresSEXP, SEXP maxitSEXP, SEXP abstolSEXP, SEXP checkpointSEXP, SEXP resumeSEXP, SEXP screenSEXP, SEXP marginSEXP, SEXP traceSEXP, SEXP solverSEXP, SEXP samplerSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type c(cSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type hypotheses(hypothesesSEXP);
+    Rcpp::traits::input_parameter< const int >::type B(BSEXP);
+    Rcpp::traits::input_parameter< const double >::type level(levelSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const bool >::type correction(correctionSEXP);
+    Rcpp::traits::input_parameter< const bool >::type approx_lambda(approx_lambdaSEXP);
+    Rcpp::traits::input_parameter< const int >::type ncores(ncoresSEXP);
+    Rcpp::traits::input_parameter< const int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const double >::type abstol(abstolSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type checkpoint(checkpointSEXP);
+    Rcpp::traits::input_parameter< const bool >::type resume(resumeSEXP);
+    Rcpp::traits::input_parameter< const bool >::type screen(screenSEXP);
+    Rcpp::traits::input_parameter< const double >::type margin(marginSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type trace(traceSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type sampler(samplerSEXP);
+    rcpp_result_gen = Rcpp::wrap(multitest_ibd(x, c, hypotheses, B, level, method, correction, approx_lambda, ncores, maxit, abstol, checkpoint, resume, screen, margin, trace, solver, sampler));
     return rcpp_result_gen;
 END_RCPP
 }
 // el_mean
-Rcpp::List el_mean(const Eigen::Map<Eigen::VectorXd>& theta, const Eigen::Map<Eigen::MatrixXd>& x, const int maxit, const double abstol);
-RcppExport SEXP _elmulttest_el_mean(SEXP thetaSEXP, SEXP xSEXP, SEXP maxitSEXP, SEXP abstolSEXP) {
+Rcpp::List el_mean(const Eigen::Map<Eigen::VectorXd>& theta, const Eigen::Map<Eigen::MatrixXd>& x, const int maxit, const double abstol, const bool details, const int ncores, const std::string solver);
+RcppExport SEXP _elmulttest_el_mean(SEXP thetaSEXP, SEXP xSEXP, SEXP maxitSEXP, SEXP abstolSEXP, SEXP detailsSEXP, SEXP ncoresSEXP, SEXP solverSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -54,15 +205,131 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd>& >::type x(xSEXP);
     Rcpp::traits::input_parameter< const int >::type maxit(maxitSEXP);
     Rcpp::traits::input_parameter< const double >::type abstol(abstolSEXP);
-    rcpp_result_gen = Rcpp::wrap(el_mean(theta, x, maxit, abstol));
+    Rcpp::traits::input_parameter< const bool >::type details(detailsSEXP);
+    Rcpp::traits::input_parameter< const int >::type ncores(ncoresSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    rcpp_result_gen = Rcpp::wrap(el_mean(theta, x, maxit, abstol, details, ncores, solver));
+    return rcpp_result_gen;
+END_RCPP
+}
+// test_mean
+Rcpp::List test_mean(const Eigen::Map<Eigen::MatrixXd>& x, const Eigen::Map<Eigen::MatrixXd>& lhs, const Eigen::Map<Eigen::VectorXd>& rhs, const int maxit, const double abstol, const std::string solver);
+RcppExport SEXP _elmulttest_test_mean(SEXP xSEXP, SEXP lhsSEXP, SEXP rhsSEXP, SEXP maxitSEXP, SEXP abstolSEXP, SEXP solverSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd>& >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd>& >::type lhs(lhsSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::VectorXd>& >::type rhs(rhsSEXP);
+    Rcpp::traits::input_parameter< const int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const double >::type abstol(abstolSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    rcpp_result_gen = Rcpp::wrap(test_mean(x, lhs, rhs, maxit, abstol, solver));
+    return rcpp_result_gen;
+END_RCPP
+}
+// el_mean_jackknife
+Rcpp::List el_mean_jackknife(const Eigen::Map<Eigen::VectorXd>& theta, const Eigen::Map<Eigen::MatrixXd>& x, const int maxit, const double abstol, const int steps, const int ncores);
+RcppExport SEXP _elmulttest_el_mean_jackknife(SEXP thetaSEXP, SEXP xSEXP, SEXP maxitSEXP, SEXP abstolSEXP, SEXP stepsSEXP, SEXP ncoresSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::VectorXd>& >::type theta(thetaSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd>& >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const double >::type abstol(abstolSEXP);
+    Rcpp::traits::input_parameter< const int >::type steps(stepsSEXP);
+    Rcpp::traits::input_parameter< const int >::type ncores(ncoresSEXP);
+    rcpp_result_gen = Rcpp::wrap(el_mean_jackknife(theta, x, maxit, abstol, steps, ncores));
+    return rcpp_result_gen;
+END_RCPP
+}
+// el_mean_stream
+SEXP el_mean_stream(const Eigen::Map<Eigen::VectorXd>& theta, const int window, const int maxit, const double abstol);
+RcppExport SEXP _elmulttest_el_mean_stream(SEXP thetaSEXP, SEXP windowSEXP, SEXP maxitSEXP, SEXP abstolSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::VectorXd>& >::type theta(thetaSEXP);
+    Rcpp::traits::input_parameter< const int >::type window(windowSEXP);
+    Rcpp::traits::input_parameter< const int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const double >::type abstol(abstolSEXP);
+    rcpp_result_gen = Rcpp::wrap(el_mean_stream(theta, window, maxit, abstol));
+    return rcpp_result_gen;
+END_RCPP
+}
+// el_mean_update
+Rcpp::List el_mean_update(SEXP stream, const Eigen::Map<Eigen::MatrixXd>& x);
+RcppExport SEXP _elmulttest_el_mean_update(SEXP streamSEXP, SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type stream(streamSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd>& >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(el_mean_update(stream, x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// el_mean_current
+Rcpp::List el_mean_current(SEXP stream);
+RcppExport SEXP _elmulttest_el_mean_current(SEXP streamSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type stream(streamSEXP);
+    rcpp_result_gen = Rcpp::wrap(el_mean_current(stream));
+    return rcpp_result_gen;
+END_RCPP
+}
+// el_2sample
+Rcpp::List el_2sample(const Eigen::Map<Eigen::VectorXd>& x, const Eigen::Map<Eigen::VectorXd>& y, const int maxit, const double abstol);
+RcppExport SEXP _elmulttest_el_2sample(SEXP xSEXP, SEXP ySEXP, SEXP maxitSEXP, SEXP abstolSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::VectorXd>& >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::VectorXd>& >::type y(ySEXP);
+    Rcpp::traits::input_parameter< const int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const double >::type abstol(abstolSEXP);
+    rcpp_result_gen = Rcpp::wrap(el_2sample(x, y, maxit, abstol));
+    return rcpp_result_gen;
+END_RCPP
+}
+// el_2sample_batch
+Rcpp::List el_2sample_batch(SEXP x, SEXP y, const int ncores, const int maxit, const double abstol);
+RcppExport SEXP _elmulttest_el_2sample_batch(SEXP xSEXP, SEXP ySEXP, SEXP ncoresSEXP, SEXP maxitSEXP, SEXP abstolSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type y(ySEXP);
+    Rcpp::traits::input_parameter< const int >::type ncores(ncoresSEXP);
+    Rcpp::traits::input_parameter< const int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const double >::type abstol(abstolSEXP);
+    rcpp_result_gen = Rcpp::wrap(el_2sample_batch(x, y, ncores, maxit, abstol));
     return rcpp_result_gen;
 END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_elmulttest_test_ibd", (DL_FUNC) &_elmulttest_test_ibd, 7},
-    {"_elmulttest_pairwise_ibd", (DL_FUNC) &_elmulttest_pairwise_ibd, 11},
-    {"_elmulttest_el_mean", (DL_FUNC) &_elmulttest_el_mean, 4},
+    {"_elmulttest_benchmark_ibd", (DL_FUNC) &_elmulttest_benchmark_ibd, 7},
+    {"_elmulttest_test_ibd", (DL_FUNC) &_elmulttest_test_ibd, 9},
+    {"_elmulttest_test_ibd_jackknife", (DL_FUNC) &_elmulttest_test_ibd_jackknife, 8},
+    {"_elmulttest_pairwise_ibd", (DL_FUNC) &_elmulttest_pairwise_ibd, 21},
+    {"_elmulttest_pairwise_ibd_async", (DL_FUNC) &_elmulttest_pairwise_ibd_async, 16},
+    {"_elmulttest_ibd_job_status", (DL_FUNC) &_elmulttest_ibd_job_status, 1},
+    {"_elmulttest_ibd_job_cancel", (DL_FUNC) &_elmulttest_ibd_job_cancel, 1},
+    {"_elmulttest_ibd_job_collect", (DL_FUNC) &_elmulttest_ibd_job_collect, 1},
+    {"_elmulttest_screening_report_ibd", (DL_FUNC) &_elmulttest_screening_report_ibd, 8},
+    {"_elmulttest_multitest_ibd", (DL_FUNC) &_elmulttest_multitest_ibd, 18},
+    {"_elmulttest_el_mean", (DL_FUNC) &_elmulttest_el_mean, 7},
+    {"_elmulttest_test_mean", (DL_FUNC) &_elmulttest_test_mean, 6},
+    {"_elmulttest_el_mean_jackknife", (DL_FUNC) &_elmulttest_el_mean_jackknife, 6},
+    {"_elmulttest_el_mean_stream", (DL_FUNC) &_elmulttest_el_mean_stream, 4},
+    {"_elmulttest_el_mean_update", (DL_FUNC) &_elmulttest_el_mean_update, 2},
+    {"_elmulttest_el_mean_current", (DL_FUNC) &_elmulttest_el_mean_current, 1},
+    {"_elmulttest_el_2sample", (DL_FUNC) &_elmulttest_el_2sample, 4},
+    {"_elmulttest_el_2sample_batch", (DL_FUNC) &_elmulttest_el_2sample_batch, 5},
     {NULL, NULL, 0}
 };
 
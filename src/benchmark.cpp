@@ -0,0 +1,312 @@
+#include "utils_ibd.h"
+#include <chrono>
+
+namespace {
+// Unreduced balanced incomplete block design: every k-subset of the p
+// treatments is a block, repeated r times. Responses are treatment effects
+// 0.1 * j plus a block effect and standard normal noise.
+void bibd(const int p, const int k, const int r,
+          Eigen::MatrixXd& x, Eigen::MatrixXd& c) {
+  std::vector<std::vector<int>> blocks;
+  std::vector<int> subset(k);
+  std::iota(subset.begin(), subset.end(), 0);
+  while (true) {
+    blocks.push_back(subset);
+    int i = k - 1;
+    while (i >= 0 && subset[i] == p - k + i) {
+      --i;
+    }
+    if (i < 0) {
+      break;
+    }
+    ++subset[i];
+    for (int j = i + 1; j < k; ++j) {
+      subset[j] = subset[j - 1] + 1;
+    }
+  }
+  const int n = r * blocks.size();
+  x = Eigen::MatrixXd::Zero(n, p);
+  c = Eigen::MatrixXd::Zero(n, p);
+  for (int i = 0; i < n; ++i) {
+    const double block_effect = R::rnorm(0, 1);
+    for (const int j : blocks[i % blocks.size()]) {
+      c(i, j) = 1;
+      x(i, j) = 0.1 * j + block_effect + R::rnorm(0, 1);
+    }
+  }
+}
+
+// median wall time of f over reps runs; before(rep) runs untimed
+template <typename F, typename S>
+double median_seconds(const int reps, F f, S before) {
+  std::vector<double> seconds(reps);
+  for (int i = 0; i < reps; ++i) {
+    before(i);
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    seconds[i] = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  }
+  std::sort(seconds.begin(), seconds.end());
+  return seconds[reps / 2];
+}
+
+// pseudo log by its definition: log(z) for z >= 1 / n, and below the
+// quadratic that matches log at 1 / n up to the second derivative
+double reference_plog_sum(const Eigen::VectorXd& z) {
+  const double n = z.size();
+  double sum = 0;
+  for (int i = 0; i < z.size(); ++i) {
+    const double d = n * z(i) - 1;
+    sum += n * z(i) < 1 ? -std::log(n) + d - 0.5 * d * d : std::log(z(i));
+  }
+  return sum;
+}
+
+// 1 - level quantile(type 7) of the maximum over the hypotheses of the
+// quadratic forms u' L'(L V L')^-1 L u, evaluated one draw u(row of U) at a
+// time
+double reference_cutoff_PB(const Eigen::MatrixXd& U,
+                           const Eigen::MatrixXd& V,
+                           const std::vector<Eigen::MatrixXd>& lhs,
+                           const double level) {
+  std::vector<double> maxima(U.rows());
+  for (int b = 0; b < U.rows(); ++b) {
+    double maximum = -std::numeric_limits<double>::infinity();
+    for (const Eigen::MatrixXd& L : lhs) {
+      const Eigen::VectorXd Lu = L * U.row(b).transpose();
+      const Eigen::MatrixXd LVL = L * V * L.transpose();
+      maximum = std::max(maximum, Lu.dot(LVL.inverse() * Lu));
+    }
+    maxima[b] = maximum;
+  }
+  std::sort(maxima.begin(), maxima.end());
+  const double index = (maxima.size() - 1) * (1 - level);
+  const std::size_t lo = static_cast<std::size_t>(index);
+  if (lo + 1 == maxima.size()) {
+    return maxima[lo];
+  }
+  return maxima[lo] + (index - lo) * (maxima[lo + 1] - maxima[lo]);
+}
+
+// Puts back the state of R's random number generator when destroyed, so
+// that seeding the benchmarks leaves the caller's stream as it was.
+class SAVED_RNG_STATE {
+public:
+  SAVED_RNG_STATE()
+    : global(Rcpp::Environment::global_env()),
+      state(global.exists(".Random.seed") ? global.get(".Random.seed") :
+              R_NilValue) {}
+  ~SAVED_RNG_STATE() {
+    if (Rf_isNull(state)) {
+      if (global.exists(".Random.seed")) {
+        global.remove(".Random.seed");
+      }
+    } else {
+      global.assign(".Random.seed", state);
+    }
+    // the exported wrapper writes the generator back to .Random.seed on
+    // return, so it is reloaded from the restored state
+    GetRNGstate();
+  }
+
+private:
+  Rcpp::Environment global;
+  const Rcpp::RObject state;
+};
+
+struct BENCHMARK_TABLE {
+  std::vector<std::string> benchmark;
+  std::vector<double> seconds;
+  std::vector<double> error;
+  std::vector<double> tolerance;
+
+  void add(const std::string& name, const double time, const double err,
+           const double tol) {
+    benchmark.push_back(name);
+    seconds.push_back(time);
+    error.push_back(err);
+    tolerance.push_back(tol);
+  }
+};
+}
+
+//' Benchmarks for the EL solvers and bootstrap cutoffs
+//'
+//' Times the solvers and cutoffs on a synthetic balanced incomplete block design and checks each result against a reference computation, so that speedups are never bought with wrong answers. The design has all k-subsets of p treatments as blocks, repeated r times. The driver in \code{inst/bench} sweeps the arguments and writes the results as JSON.
+//'
+//' @param p number of treatments.
+//' @param k block size.
+//' @param r number of repetitions of the design. The number of blocks is r * choose(p, k).
+//' @param ncores number of cores(threads) for the cutoffs. Defaults to 1.
+//' @param B number of bootstrap replicates for the cutoffs. Defaults to 200.
+//' @param reps number of timed runs; the median is reported. Defaults to 3.
+//' @param seed random seed for the design and the bootstrap. The state of the random number generator is restored on return. Defaults to 1.
+//' @return A data frame with the benchmark, design parameters, median seconds, the error of its accuracy check, the tolerance of the check and whether it passed. The relative difference between the screened and the exhaustive NB cutoffs is reported with an infinite tolerance, since screening is heuristic.
+//' @export
+// [[Rcpp::export]]
+Rcpp::DataFrame benchmark_ibd(const int p,
+                              const int k,
+                              const int r,
+                              const int ncores = 1,
+                              const int B = 200,
+                              const int reps = 3,
+                              const int seed = 1) {
+  if (k < 2 || k > p || r < 1 || reps < 1) {
+    Rcpp::stop("Invalid design: need 2 <= k <= p and r >= 1.");
+  }
+  const SAVED_RNG_STATE saved;
+  Rcpp::Function set_seed("set.seed");
+  set_seed(seed);
+  Eigen::MatrixXd x, c;
+  bibd(p, k, r, x, c);
+  const int n = x.rows();
+  const int maxit = 1000;
+  const double abstol = 1e-8;
+  const Eigen::SparseMatrix<double> c_sparse = c.sparseView();
+  const Eigen::VectorXd theta_hat = col_sums(x).cwiseQuotient(col_sums(c));
+  // hypothesis theta_1 = theta_2
+  Eigen::MatrixXd lhs = Eigen::MatrixXd::Zero(1, p);
+  lhs(0) = 1;
+  lhs(1) = -1;
+  const Eigen::VectorXd rhs = Eigen::VectorXd::Zero(1);
+  const Eigen::VectorXd theta1 = linear_projection(theta_hat, lhs, rhs);
+  const Eigen::MatrixXd g = g_ibd(theta1, x, c);
+  const auto none = [](const int) {};
+  BENCHMARK_TABLE table;
+
+  // inner solvers
+  const EL2 el2(g, maxit, abstol);
+  const Eigen::VectorXd z = Eigen::VectorXd::Ones(n) + g * el2.lambda;
+  double seconds = median_seconds(reps, [&] {
+    const PSEUDO_LOG log((Eigen::VectorXd(z)));
+  }, none);
+  table.add("PSEUDO_LOG", seconds,
+            std::abs(PSEUDO_LOG(Eigen::VectorXd(z)).plog_sum -
+              reference_plog_sum(z)), 1e-8 * n);
+  EL el;
+  seconds = median_seconds(reps, [&] {el = getEL(g, maxit, abstol);}, none);
+  table.add("getEL", seconds, std::abs(el.nlogLR - el2.nlogLR), 1e-6);
+  seconds = median_seconds(reps, [&] {EL2 eval(g, maxit, abstol);}, none);
+  table.add("EL2", seconds, (el.lambda - el2.lambda).norm(), 1e-4);
+  // linearized lambda for a small step in theta against the solved lambda
+  const Eigen::VectorXd theta2 = theta1 + 0.01 * (theta_hat - theta1);
+  const Eigen::VectorXd lambda2 =
+    EL2(g_ibd(theta2, x, c), maxit, abstol).lambda;
+  Eigen::VectorXd lambda_approx;
+  seconds = median_seconds(reps, [&] {
+    lambda_approx = approx_lambda_ibd(g, c, theta1, theta2, el2.lambda);
+  }, none);
+  table.add("approx_lambda_ibd", seconds,
+            (lambda_approx - lambda2).norm() / std::max(1.0, lambda2.norm()),
+            0.05);
+
+  // test_ibd_EL against the joint KKT Newton solver at a tight tolerance,
+  // and its variants against the dense exact solution
+  minEL exact;
+  seconds = median_seconds(reps, [&] {
+    exact = test_ibd_EL(x, c, lhs, rhs, maxit, abstol);
+  }, none);
+  minEL joint;
+  {
+    const EL_SOLVER solver("joint");
+    joint = test_ibd_EL(x, c, lhs, rhs, maxit, 1e-12);
+  }
+  table.add("test_ibd_EL", seconds,
+            exact.convergence && joint.convergence ?
+              std::abs(exact.nlogLR - joint.nlogLR) :
+              std::numeric_limits<double>::infinity(),
+            1e-6 * std::max(1.0, joint.nlogLR));
+  minEL sparse;
+  seconds = median_seconds(reps, [&] {
+    sparse = test_ibd_EL(theta_hat, x, SparseRef(c_sparse), lhs, rhs,
+                         maxit, abstol);
+  }, none);
+  table.add("test_ibd_EL sparse", seconds,
+            std::abs(sparse.nlogLR - exact.nlogLR),
+            1e-8 * std::max(1.0, exact.nlogLR));
+  minEL approx;
+  seconds = median_seconds(reps, [&] {
+    approx = test_ibd_EL_approx(x, c, lhs, rhs, maxit, abstol);
+  }, none);
+  table.add("test_ibd_EL_approx", seconds,
+            std::abs(approx.nlogLR - exact.nlogLR) /
+              std::max(1.0, exact.nlogLR), 1e-4);
+
+  // confidence interval at the 95% chi-square(1) cutoff: each endpoint is
+  // inside and the point 1e-4 beyond it is outside
+  const double threshold = 3.841459;
+  std::array<double, 2> ci;
+  seconds = median_seconds(reps, [&] {
+    ci = pair_confidence_interval_ibd(theta_hat, x, c, lhs,
+                                      theta_hat(0) - theta_hat(1), threshold);
+  }, none);
+  double violation = 0;
+  for (int side = 0; side < 2; ++side) {
+    const double step = side == 0 ? -1e-4 : 1e-4;
+    const double inside = 2 * test_ibd_EL(
+      theta_hat, x, c, lhs, Eigen::VectorXd::Constant(1, ci[side]),
+      maxit, abstol).nlogLR;
+    const double outside = 2 * test_ibd_EL(
+      theta_hat, x, c, lhs, Eigen::VectorXd::Constant(1, ci[side] + step),
+      maxit, abstol).nlogLR;
+    violation = std::max({violation, inside - threshold, threshold - outside});
+  }
+  table.add("pair_confidence_interval_ibd", seconds, violation, 0);
+
+  // cutoffs; PB is checked against the explicit maxima of the quadratic
+  // forms of the same normal draws, NB against a serial rerun on the same
+  // bootstrap samples
+  const std::vector<Eigen::MatrixXd> pairs = pair_hypotheses(all_pairs(p), p);
+  const Eigen::MatrixXd V_hat = cov_ibd(x, c);
+  const auto reseed = [&](const int) {set_seed(seed);};
+  double cutoff = 0;
+  seconds = median_seconds(reps, [&] {
+    cutoff = cutoff_PB(V_hat, n, pairs, B, 0.05, false);
+  }, reseed);
+  set_seed(seed);
+  const double reference = reference_cutoff_PB(rmvn(V_hat, B), V_hat, pairs,
+                                               0.05);
+  table.add("cutoff_PB", seconds, std::abs(cutoff - reference),
+            1e-8 * std::max(1.0, reference));
+  for (const bool approx_lambda : {false, true}) {
+    const std::string name = approx_lambda ? "cutoff_NB_approx" : "cutoff_NB";
+    seconds = median_seconds(reps, [&] {
+      cutoff = cutoff_NB(x, c, pairs, B, 0.05, approx_lambda, ncores,
+                         maxit, abstol, name);
+    }, reseed);
+    set_seed(seed);
+    const double serial = cutoff_NB(x, c, pairs, B, 0.05, approx_lambda, 1,
+                                    maxit, abstol, name);
+    double screened = 0;
+    const double screened_seconds = median_seconds(reps, [&] {
+      screened = cutoff_NB(x, c, pairs, B, 0.05, approx_lambda, ncores,
+                           maxit, abstol, name, "", false, true);
+    }, reseed);
+    table.add(name, seconds, std::abs(cutoff - serial),
+              1e-8 * std::max(1.0, std::abs(cutoff)));
+    // a screened pair may be missed if its Euclidean statistic is below the
+    // exact one by more than the margin, which nothing bounds; the
+    // difference is reported rather than checked
+    table.add(name + " screened", screened_seconds,
+              std::abs(cutoff - screened) / std::max(1.0, std::abs(cutoff)),
+              std::numeric_limits<double>::infinity());
+  }
+
+  const int size = table.benchmark.size();
+  Rcpp::LogicalVector passed(size);
+  for (int i = 0; i < size; ++i) {
+    passed[i] = table.error[i] <= table.tolerance[i];
+  }
+  return Rcpp::DataFrame::create(
+    Rcpp::Named("benchmark") = table.benchmark,
+    Rcpp::Named("n") = std::vector<int>(size, n),
+    Rcpp::Named("p") = std::vector<int>(size, p),
+    Rcpp::Named("k") = std::vector<int>(size, k),
+    Rcpp::Named("ncores") = std::vector<int>(size, ncores),
+    Rcpp::Named("seconds") = table.seconds,
+    Rcpp::Named("error") = table.error,
+    Rcpp::Named("tolerance") = table.tolerance,
+    Rcpp::Named("passed") = passed,
+    Rcpp::Named("stringsAsFactors") = false);
+}
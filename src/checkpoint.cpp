@@ -0,0 +1,231 @@
+#include "checkpoint.h"
+#include <cstring>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+const char checkpoint_magic[8] = {'E', 'L', 'C', 'K', 'P', 'T', '0', '1'};
+
+struct HEADER {
+  char magic[8];
+  char method[8];
+  std::int32_t n;
+  std::int32_t p;
+  std::int32_t B;
+  std::uint64_t key;
+};
+
+bool read_header(std::FILE* f, HEADER& h) {
+  return std::fread(h.magic, 1, 8, f) == 8 &&
+    std::fread(h.method, 1, 8, f) == 8 &&
+    std::fread(&h.n, sizeof(h.n), 1, f) == 1 &&
+    std::fread(&h.p, sizeof(h.p), 1, f) == 1 &&
+    std::fread(&h.B, sizeof(h.B), 1, f) == 1 &&
+    std::fread(&h.key, sizeof(h.key), 1, f) == 1;
+}
+
+bool write_header(std::FILE* f, const HEADER& h) {
+  return std::fwrite(h.magic, 1, 8, f) == 8 &&
+    std::fwrite(h.method, 1, 8, f) == 8 &&
+    std::fwrite(&h.n, sizeof(h.n), 1, f) == 1 &&
+    std::fwrite(&h.p, sizeof(h.p), 1, f) == 1 &&
+    std::fwrite(&h.B, sizeof(h.B), 1, f) == 1 &&
+    std::fwrite(&h.key, sizeof(h.key), 1, f) == 1;
+}
+
+void sync(std::FILE* f) {
+  std::fflush(f);
+#ifdef _WIN32
+  _commit(_fileno(f));
+#else
+  fsync(fileno(f));
+#endif
+}
+}
+
+std::uint64_t fingerprint(const void* data,
+                          const std::size_t size,
+                          std::uint64_t seed) {
+  // FNV-1a over 8-byte words, with a shift that carries the high bits of a
+  // word into the low bits of the state, and over the bytes of the tail
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  std::size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    std::uint64_t word;
+    std::memcpy(&word, bytes + i, 8);
+    seed ^= word;
+    seed *= 1099511628211ULL;
+    seed ^= seed >> 32;
+  }
+  for (; i < size; ++i) {
+    seed ^= bytes[i];
+    seed *= 1099511628211ULL;
+  }
+  return seed;
+}
+
+CHECKPOINT::CHECKPOINT(const std::string& path,
+                       const bool resume,
+                       const std::string& method,
+                       const int n,
+                       const int p,
+                       const int B,
+                       const std::uint64_t key,
+                       const int batch)
+  : path(path), batch(batch), completed(B, 0), values(B) {
+  if (path.empty()) {
+    return;
+  }
+  HEADER header;
+  std::copy(checkpoint_magic, checkpoint_magic + 8, header.magic);
+  std::fill(header.method, header.method + 8, '\0');
+  method.copy(header.method, 7);
+  header.n = n;
+  header.p = p;
+  header.B = B;
+  header.key = key;
+
+  // read completed replicates from an existing file
+  std::FILE* old = resume ? std::fopen(path.c_str(), "rb") : nullptr;
+  if (old) {
+    HEADER h;
+    if (!read_header(old, h) ||
+        !std::equal(h.magic, h.magic + 8, header.magic) ||
+        !std::equal(h.method, h.method + 8, header.method) ||
+        h.n != n || h.p != p || h.B != B) {
+      std::fclose(old);
+      native::stop("Checkpoint file '%s' does not belong to this run.", path);
+    }
+    if (h.key != key) {
+      std::fclose(old);
+      native::stop("Data or bootstrap samples differ from checkpoint file '%s'. Use the same data, options and seed to resume.", path);
+    }
+    std::int32_t b;
+    double statistic;
+    // a partially written trailing record is ignored
+    while (std::fread(&b, sizeof(b), 1, old) == 1 &&
+           std::fread(&statistic, sizeof(statistic), 1, old) == 1) {
+      if (b >= 0 && b < B && !completed[b]) {
+        completed[b] = 1;
+        values[b] = statistic;
+        ++n_resumed;
+      }
+    }
+    std::fclose(old);
+  }
+
+  // rewrite the file with the valid records only, into a temporary file
+  // that replaces it once written, so an interrupted rewrite loses nothing
+  const std::string temporary = path + ".tmp";
+  file = std::fopen(temporary.c_str(), "wb");
+  if (!file) {
+    native::stop("Unable to open checkpoint file '%s'.", temporary);
+  }
+  if (!write_header(file, header)) {
+    failed = true;
+  }
+  for (int i = 0; i < B; ++i) {
+    if (completed[i]) {
+      buffer.push_back({i, values[i]});
+    }
+  }
+  write(buffer, true);
+  buffer.clear();
+  const bool written = !failed && std::fclose(file) == 0;
+  file = nullptr;
+#ifdef _WIN32
+  // rename does not replace an existing file
+  if (written) {
+    std::remove(path.c_str());
+  }
+#endif
+  if (!written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+    std::remove(temporary.c_str());
+    native::stop("Unable to write checkpoint file '%s'.", path);
+  }
+  file = std::fopen(path.c_str(), "ab");
+  if (!file) {
+    native::stop("Unable to open checkpoint file '%s'.", path);
+  }
+  buffer.reserve(batch);
+}
+
+CHECKPOINT::~CHECKPOINT() {
+  if (file) {
+    std::fclose(file);
+  }
+}
+
+void CHECKPOINT::record(const int b, const double statistic) {
+  if (!file) {
+    return;
+  }
+  std::vector<RECORD> full;
+  #pragma omp critical(checkpoint)
+  {
+    buffer.push_back({b, statistic});
+    if (static_cast<int>(buffer.size()) >= batch) {
+      full.swap(buffer);
+      buffer.reserve(batch);
+    }
+  }
+  // other workers keep recording while a full batch goes to disk
+  if (!full.empty()) {
+    #pragma omp critical(checkpoint_file)
+    write(full, false);
+  }
+}
+
+void CHECKPOINT::record(const int begin,
+                        const double* statistics,
+                        const int size) {
+  if (!file) {
+    return;
+  }
+  std::vector<RECORD> records(size);
+  for (int k = 0; k < size; ++k) {
+    records[k] = {begin + k, statistics[k]};
+  }
+  #pragma omp critical(checkpoint_file)
+  write(records, false);
+}
+
+void CHECKPOINT::close() {
+  if (!file) {
+    return;
+  }
+  write(buffer, false);
+  buffer.clear();
+  std::fclose(file);
+  file = nullptr;
+  if (failed) {
+    native::warning("Failed to write checkpoint file '%s'.", path);
+  }
+}
+
+void CHECKPOINT::write(const std::vector<RECORD>& records,
+                       const bool durable) {
+  // records are packed without padding
+  const std::size_t size = sizeof(std::int32_t) + sizeof(double);
+  std::vector<char> bytes(size * records.size());
+  for (std::size_t k = 0; k < records.size(); ++k) {
+    std::memcpy(&bytes[size * k], &records[k].b, sizeof(std::int32_t));
+    std::memcpy(&bytes[size * k + sizeof(std::int32_t)],
+                &records[k].statistic, sizeof(double));
+  }
+  if (std::fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+    failed = true;
+  }
+  // a crash of the process loses nothing written; a crash of the system
+  // loses at most the last second of records
+  const auto now = std::chrono::steady_clock::now();
+  if (durable || now - synced >= std::chrono::seconds(1)) {
+    sync(file);
+    synced = now;
+  } else {
+    std::fflush(file);
+  }
+}
@@ -0,0 +1,58 @@
+#ifndef EL_CHECKPOINT_H_
+#define EL_CHECKPOINT_H_
+
+#include "native.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+std::uint64_t fingerprint(const void* data,
+                          const std::size_t size,
+                          std::uint64_t seed = 14695981039346656037ULL);
+
+// Append-only checkpoint file for bootstrap replicates.
+// Layout: a fixed header identifying the run followed by (replicate, value)
+// records. Records are buffered and written in batches outside the lock that
+// guards the buffer; the file is synced to disk with fsync at most once per
+// second. An empty path disables checkpointing.
+class CHECKPOINT {
+public:
+  CHECKPOINT(const std::string& path,
+             const bool resume,
+             const std::string& method,
+             const int n,
+             const int p,
+             const int B,
+             const std::uint64_t key,
+             const int batch = 256);
+  ~CHECKPOINT();
+
+  bool active() const {return file != nullptr;}
+  bool done(const int b) const {return active() && completed[b];}
+  double value(const int b) const {return values[b];}
+  int resumed() const {return n_resumed;}
+  // thread-safe; called from worker threads
+  void record(const int b, const double statistic);
+  // records statistics[k] for replicates begin + k, k < size, as one batch
+  void record(const int begin, const double* statistics, const int size);
+  // write remaining records; called from the main thread
+  void close();
+
+private:
+  struct RECORD {
+    std::int32_t b;
+    double statistic;
+  };
+  std::FILE* file = nullptr;
+  std::string path;
+  int batch;
+  int n_resumed = 0;
+  bool failed = false;
+  std::vector<char> completed;
+  std::vector<double> values;
+  std::vector<RECORD> buffer;
+  std::chrono::steady_clock::time_point synced;
+
+  void write(const std::vector<RECORD>& records, const bool durable);
+};
+#endif
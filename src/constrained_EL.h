@@ -0,0 +1,486 @@
+#ifndef EL_CONSTRAINED_H_
+#define EL_CONSTRAINED_H_
+
+#include "EL.h"
+#include "scheduler.h"
+#include "utils.h"
+#include "trace.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Minimization of -logLR over theta subject to lhs * theta = rhs for a model
+// given as a policy class. Calls are resolved at compile time, so each model
+// gets its own inlined copy of the loops below. A model supplies
+//
+//   Eigen::MatrixXd g(theta)
+//     n x m estimating functions at theta
+//   Eigen::VectorXd theta_gradient(theta, lambda, dplog)
+//     gradient in theta of sum(plog(1 + g(theta) * lambda)), dplog the
+//     derivative of plog at 1 + g(theta) * lambda
+//   double step_size()
+//     initial step of the projected gradient descent
+//   Eigen::MatrixXd range()
+//     p x 2 box(lower, upper) of theta outside of which 0 is not in the
+//     convex hull of g(theta); infinite bounds when unknown
+//   void kkt_blocks(theta, lambda, g, dplog, neg_d2plog, H_tl, H_tt)
+//     p x m and p x p blocks d2F/dtheta dlambda and d2F/dtheta2, used only
+//     by the JOINT solver
+//   void kkt_row(i, theta, lambda, g_i, dplog_i, neg_d2plog_i, gradient,
+//                H_tl, H_tt)
+//     the terms of observation i in theta_gradient and kkt_blocks, used
+//     only by jackknife_EL
+//
+// and test_ibd_EL, test_mean and the bootstrap built on them follow.
+
+// Newton system of the KKT conditions in (theta, lambda, nu) at a point,
+// from M = -d2F/dlambda2 and the blocks of kkt_blocks. The lambda block is
+// eliminated, leaving a bordered system of size p + q that is factorized
+// once and solved for any residuals.
+class KKT_SYSTEM {
+public:
+  KKT_SYSTEM(const Eigen::LDLT<Eigen::MatrixXd>& M,
+             const Eigen::MatrixXd& H_tl,
+             const Eigen::MatrixXd& H_tt,
+             const Eigen::Ref<const Eigen::MatrixXd>& lhs)
+    : M(M), H_tl(H_tl) {
+    const int p = H_tt.rows();
+    const int q = lhs.rows();
+    const Eigen::MatrixXd MH = M.solve(H_tl.transpose());
+    Eigen::MatrixXd K = Eigen::MatrixXd::Zero(p + q, p + q);
+    K.topLeftCorner(p, p) = H_tt + H_tl * MH;
+    K.topRightCorner(p, q) = -lhs.transpose();
+    K.bottomLeftCorner(q, p) = -lhs;
+    lu.compute(K);
+  }
+
+  // step(d_theta, d_lambda, d_nu) for the residuals r(theta, lambda and
+  // constraint blocks); false if it is not finite
+  bool solve(const Eigen::VectorXd& r, Eigen::VectorXd& d) const {
+    const int p = H_tl.rows();
+    const int m = H_tl.cols();
+    const int q = r.size() - p - m;
+    Eigen::VectorXd b(p + q);
+    b << -r.head(p) - H_tl * M.solve(r.segment(p, m)), r.tail(q);
+    const Eigen::VectorXd step = lu.solve(b);
+    d.resize(p + m + q);
+    d << step.head(p),
+         M.solve(r.segment(p, m) + H_tl.transpose() * step.head(p)),
+         step.tail(q);
+    return d.allFinite();
+  }
+
+private:
+  Eigen::LDLT<Eigen::MatrixXd> M;
+  Eigen::MatrixXd H_tl;
+  Eigen::FullPivLU<Eigen::MatrixXd> lu;
+};
+
+// Saddle point of sum(plog(1 + g(theta) * lambda)), minimized over theta
+// subject to lhs * theta = rhs and maximized over lambda, by damped Newton
+// steps on the KKT conditions in (theta, lambda, nu), nu the multipliers of
+// the constraint. The lambda block is eliminated, leaving a bordered system
+// of size p + q, so a step costs a few products of the n x m matrices like
+// one inner Newton step. Steps are halved until the squared norm of the KKT
+// residuals decreases sufficiently.
+template <typename Model>
+minEL joint_EL(const Model& model,
+               Eigen::VectorXd theta,
+               Eigen::VectorXd lambda,
+               const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+               const Eigen::Ref<const Eigen::VectorXd>& rhs,
+               const int maxit,
+               const double abstol) {
+  const int p = theta.size();
+  const int m = lambda.size();
+  const int q = lhs.rows();
+  // residuals(theta, lambda and constraint blocks) at a point; g and plog
+  // are kept for the next Newton system
+  Eigen::MatrixXd g;
+  const auto residual = [&](const Eigen::VectorXd& theta,
+                            const Eigen::VectorXd& lambda,
+                            const Eigen::VectorXd& nu,
+                            Eigen::MatrixXd& g) {
+    g = model.g(theta);
+    PSEUDO_LOG log(Eigen::VectorXd::Ones(g.rows()) + g * lambda);
+    const Eigen::VectorXd d1 = log.dplog.matrix();
+    Eigen::VectorXd r(p + m + q);
+    r << model.theta_gradient(theta, lambda, d1) - lhs.transpose() * nu,
+         g.transpose() * d1,
+         lhs * theta - rhs;
+    return std::make_pair(std::move(r), std::move(log));
+  };
+  // multipliers start at the least squares fit to the theta gradient
+  Eigen::VectorXd nu = Eigen::VectorXd::Zero(q);
+  auto state = residual(theta, lambda, nu, g);
+  nu = lhs.transpose().colPivHouseholderQr().solve(state.first.head(p));
+  state.first.head(p) -= lhs.transpose() * nu;
+  double merit = state.first.squaredNorm();
+
+  int iterations = 0;
+  bool convergence = false;
+  Eigen::MatrixXd H_tl, H_tt;
+  while (!convergence && iterations != maxit) {
+    const Eigen::VectorXd& r = state.first;
+    const PSEUDO_LOG& log = state.second;
+    // -d2F/dlambda2, d2F/dtheta dlambda and d2F/dtheta2
+    const Eigen::MatrixXd J = g.array().colwise() * log.sqrt_neg_d2plog;
+    model.kkt_blocks(theta, lambda, g, log.dplog.matrix(),
+                     log.sqrt_neg_d2plog.square().matrix(), H_tl, H_tt);
+    const KKT_SYSTEM system(Eigen::LDLT<Eigen::MatrixXd>(J.transpose() * J),
+                            H_tl, H_tt, lhs);
+    Eigen::VectorXd d;
+    const bool finite = system.solve(r, d);
+    const Eigen::VectorXd d_theta = d.head(p);
+    const Eigen::VectorXd d_lambda = d.segment(p, m);
+    const Eigen::VectorXd d_nu = d.tail(q);
+    if (!finite) {
+      el_warning("Convex hull constraint not satisfied during optimization. Optimization halted.");
+      break;
+    }
+
+    // step halving on the merit function
+    double t = 1;
+    Eigen::MatrixXd g_tmp;
+    auto state_tmp = residual(theta + d_theta, lambda + d_lambda, nu + d_nu,
+                              g_tmp);
+    while (state_tmp.first.squaredNorm() > (1 - 2e-4 * t) * merit) {
+      TRACE_SPAN span("step halving", iterations);
+      t /= 2;
+      if (t < abstol) {
+        break;
+      }
+      state_tmp = residual(theta + t * d_theta, lambda + t * d_lambda,
+                           nu + t * d_nu, g_tmp);
+    }
+    if (t < abstol) {
+      el_warning("Convex hull constraint not satisfied during step halving.");
+      break;
+    }
+    theta += t * d_theta;
+    lambda += t * d_lambda;
+    nu += t * d_nu;
+    g = std::move(g_tmp);
+    state = std::move(state_tmp);
+    merit = state.first.squaredNorm();
+
+    // convergence check
+    if (merit < abstol) {
+      convergence = true;
+    } else {
+      ++iterations;
+    }
+  }
+
+  return {theta, lambda, state.second.plog_sum, iterations, convergence, 0};
+}
+
+// Leave-one-out solutions, row i for the data without observation i
+struct jackknifeEL {
+  Eigen::MatrixXd theta;
+  Eigen::MatrixXd lambda;
+  Eigen::VectorXd nlogLR;
+  // observations whose problem was not updated; the caller solves those
+  // from scratch
+  std::vector<char> failed;
+};
+
+// Leave-one-out -logLR from the solution full of the problem on all n
+// observations, in place of n solves of size n - 1. Deleting observation i
+// subtracts its terms from the KKT residuals and a rank-one term from
+// M = J'J, so the factorization of M is downdated in O(m^2) and the
+// bordered system rebuilt in O(p^3). -logLR after one Newton step from the
+// full solution is given by the quadratic model of the Lagrangian. With
+// steps > 1 the later Newton steps are taken on the n - 1 observations at
+// O(n * m^2) each, and the model is applied after the last step. An
+// update fails if the leverage of the observation in M exceeds 1/2, a step
+// is not finite or the pseudo log of another observation leaves the log
+// branch at n - 1.
+template <typename Model>
+jackknifeEL jackknife_EL(const Model& model,
+                         const minEL& full,
+                         const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+                         const Eigen::Ref<const Eigen::VectorXd>& rhs,
+                         const int steps,
+                         const int ncores) {
+  const Eigen::VectorXd& theta = full.theta;
+  const Eigen::VectorXd& lambda = full.lambda;
+  const Eigen::MatrixXd g = model.g(theta);
+  const int n = g.rows();
+  const int p = theta.size();
+  const int m = lambda.size();
+  const int q = lhs.rows();
+  const Eigen::VectorXd z = Eigen::VectorXd::Ones(n) + g * lambda;
+  const PSEUDO_LOG log{Eigen::VectorXd(z)};
+  const auto drop = [n](const Eigen::VectorXd& v, const int i) {
+    Eigen::VectorXd out(n - 1);
+    out << v.head(i), v.tail(n - 1 - i);
+    return out;
+  };
+
+  // KKT residuals at the full solution, the multipliers fitted by least
+  // squares, and the blocks of the Newton system
+  Eigen::VectorXd r(p + m + q);
+  r << model.theta_gradient(theta, lambda, log.dplog.matrix()),
+       g.transpose() * log.dplog.matrix(),
+       lhs * theta - rhs;
+  const Eigen::VectorXd nu =
+    lhs.transpose().colPivHouseholderQr().solve(r.head(p));
+  r.head(p) -= lhs.transpose() * nu;
+  const Eigen::MatrixXd J = g.array().colwise() * log.sqrt_neg_d2plog;
+  const Eigen::LDLT<Eigen::MatrixXd> M(J.transpose() * J);
+  Eigen::MatrixXd H_tl, H_tt;
+  model.kkt_blocks(theta, lambda, g, log.dplog.matrix(),
+                   log.sqrt_neg_d2plog.square().matrix(), H_tl, H_tt);
+  // observations on the quadratic branch of the pseudo log at n - 1
+  std::vector<int> low;
+  for (int i = 0; i < n; ++i) {
+    if ((n - 1) * z[i] < 1) {
+      low.push_back(i);
+    }
+  }
+
+  jackknifeEL out{Eigen::MatrixXd(n, p), Eigen::MatrixXd(n, m),
+                  Eigen::VectorXd(n), std::vector<char>(n, 1)};
+  parallel_pairs(1, n, pair_block_size(1, n, ncores), ncores,
+                 [&](const int, const int begin, const int end) {
+    Eigen::VectorXd gradient, d;
+    Eigen::MatrixXd H_tl_i, H_tt_i;
+    for (int i = begin; i < end; ++i) {
+      if (low.size() > 1 || (low.size() == 1 && low[0] != i)) {
+        continue;
+      }
+      const double s = log.sqrt_neg_d2plog[i];
+      const double d1 = log.dplog[i];
+      const Eigen::VectorXd g_i = g.row(i).transpose();
+      // leverage of observation i in M; near 1 its deletion moves the
+      // solution beyond the reach of local steps
+      if (s * s * g_i.dot(M.solve(g_i)) > 0.5) {
+        continue;
+      }
+      model.kkt_row(i, theta, lambda, g_i, d1, s * s, gradient, H_tl_i,
+                    H_tt_i);
+      Eigen::LDLT<Eigen::MatrixXd> M_i(M);
+      M_i.rankUpdate(s * g_i, -1);
+      KKT_SYSTEM system(M_i, H_tl - H_tl_i, H_tt - H_tt_i, lhs);
+      Eigen::VectorXd r_i = r;
+      r_i.head(p) -= gradient;
+      r_i.segment(p, m) -= d1 * g_i;
+      // the term of observation i is a log unless it is on the quadratic
+      // branch, and so are all the others
+      double f = n * z[i] >= 1 ? log.plog_sum - std::log(z[i]) :
+        PSEUDO_LOG::sum(drop(z, i));
+
+      Eigen::VectorXd theta_i = theta;
+      Eigen::VectorXd lambda_i = lambda;
+      Eigen::VectorXd nu_i = nu;
+      bool finite = true;
+      for (int k = 1; finite; ++k) {
+        finite = system.solve(r_i, d) && std::isfinite(f);
+        if (!finite) {
+          break;
+        }
+        theta_i += d.head(p);
+        lambda_i += d.segment(p, m);
+        nu_i += d.tail(q);
+        if (k >= steps) {
+          f += 0.5 * r_i.head(p + m).dot(d.head(p + m));
+          break;
+        }
+        // Newton system on the remaining observations, with zero
+        // derivatives at observation i
+        Eigen::MatrixXd g_k = model.g(theta_i);
+        const PSEUDO_LOG log_k(
+          drop(Eigen::VectorXd::Ones(n) + g_k * lambda_i, i));
+        Eigen::VectorXd d1_k(n), s_k(n);
+        d1_k << log_k.dplog.head(i).matrix(), 0,
+                log_k.dplog.tail(n - 1 - i).matrix();
+        s_k << log_k.sqrt_neg_d2plog.head(i).matrix(), 0,
+               log_k.sqrt_neg_d2plog.tail(n - 1 - i).matrix();
+        r_i << model.theta_gradient(theta_i, lambda_i, d1_k) -
+                 lhs.transpose() * nu_i,
+               g_k.transpose() * d1_k,
+               lhs * theta_i - rhs;
+        f = log_k.plog_sum;
+        model.kkt_blocks(theta_i, lambda_i, g_k, d1_k,
+                         s_k.cwiseAbs2(), H_tl_i, H_tt_i);
+        g_k = g_k.array().colwise() * s_k.array();
+        system = KKT_SYSTEM(Eigen::LDLT<Eigen::MatrixXd>(g_k.transpose() * g_k),
+                            H_tl_i, H_tt_i, lhs);
+      }
+      out.theta.row(i) = theta_i;
+      out.lambda.row(i) = lambda_i;
+      out.nlogLR[i] = f;
+      out.failed[i] = !finite || !std::isfinite(f);
+    }
+  });
+  return out;
+}
+
+// Projected gradient descent on theta with lambda solved by EL2 at each
+// proposal, starting from the projection of theta0. The minimization stops
+// early once -logLR is certified not to exceed bound; el_method() == JOINT
+// hands over to joint_EL after the initial lambda.
+template <typename Model>
+minEL constrained_EL(const Model& model,
+                     const Eigen::Ref<const Eigen::VectorXd>& theta0,
+                     const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+                     const Eigen::Ref<const Eigen::VectorXd>& rhs,
+                     const int maxit,
+                     const double abstol,
+                     const double bound =
+                       -std::numeric_limits<double>::infinity()) {
+  /// initialization ///
+  // Constraint imposed on the initial value by projection.
+  Eigen::VectorXd theta =
+    linear_projection(theta0, lhs, rhs);
+  // no theta satisfying the constraint has 0 inside the convex hull
+  if (range_separated(model.range(), lhs, rhs)) {
+    return {theta, Eigen::VectorXd::Zero(theta.size()),
+            std::numeric_limits<double>::infinity(), 0, false, 0};
+  }
+  // estimating function
+  Eigen::MatrixXd g = model.g(theta);
+  // evaluation
+  const EL2 eval0(g);
+  Eigen::VectorXd lambda = eval0.lambda;
+  // for current function value(-logLR) and the scale of its terms
+  double scale;
+  double f1 =
+    PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g.rows()) + g * lambda, scale);
+  // Each iterate satisfies the constraint, so f1 bounds the minimum from
+  // above once lambda is solved. The search stops when it cannot exceed bound.
+  if (eval0.convergence && f1 <= bound) {
+    return {theta, lambda, f1, 0, false, 0};
+  }
+  if (el_method() == JOINT) {
+    return joint_EL(model, std::move(theta), std::move(lambda), lhs, rhs,
+                    maxit, abstol);
+  }
+
+  /// minimization(projected gradient descent) ///
+  double gamma = model.step_size();
+  bool convergence = false;
+  int iterations = 0;
+  // gradient step on theta with lambda fixed, then projection
+  const auto propose = [&](const Eigen::VectorXd& theta,
+                           const Eigen::VectorXd& lambda,
+                           const Eigen::MatrixXd& g) {
+    Eigen::VectorXd theta_tmp = theta - gamma * model.theta_gradient(
+      theta, lambda,
+      PSEUDO_LOG::dp(Eigen::VectorXd::Ones(g.rows()) + g * lambda).matrix());
+    linear_projection_void(theta_tmp, lhs, rhs);
+    return theta_tmp;
+  };
+  while (!convergence && iterations != maxit) {
+    // update parameter by GD with lambda fixed -> projection
+    Eigen::VectorXd theta_tmp = propose(theta, lambda, g);
+    // update g
+    Eigen::MatrixXd g_tmp = model.g(theta_tmp);
+    // update lambda
+    EL2 eval(g_tmp);
+    Eigen::VectorXd lambda_tmp = eval.lambda;
+    bool solved = eval.convergence;
+    if (!eval.convergence && iterations > 9) {
+      lambda = std::move(lambda_tmp);
+      el_warning("Convex hull constraint not satisfied during optimization. Optimization halted.");
+      break;
+    }
+
+    // update function value
+    double f0 = f1;
+    f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g_tmp.rows()) + g_tmp * lambda_tmp,
+                         scale);
+
+    // step halving to ensure that the updated function value be
+    // strictly less than the current function value, up to rounding
+    while (f1 - f0 > PSEUDO_LOG::resolution(scale)) {
+      TRACE_SPAN span("step halving", iterations);
+      // reduce step size
+      gamma /= 2;
+      // propose new theta
+      theta_tmp = propose(theta, lambda, g);
+      // propose new lambda
+      g_tmp = model.g(theta_tmp);
+      const EL2 eval_tmp(g_tmp);
+      lambda_tmp = eval_tmp.lambda;
+      solved = eval_tmp.convergence;
+      if (gamma < abstol) {
+        lambda = std::move(lambda_tmp);
+        el_warning("Convex hull constraint not satisfied during step halving.");
+        break;
+      }
+      // propose new function value
+      f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g_tmp.rows()) + g_tmp * lambda_tmp,
+                           scale);
+    }
+
+    // update parameters
+    theta = std::move(theta_tmp);
+    lambda = std::move(lambda_tmp);
+    g = std::move(g_tmp);
+
+    // convergence check
+    if (f0 - f1 < PSEUDO_LOG::tolerance(abstol, scale) && iterations > 0) {
+      convergence = true;
+    } else {
+      ++iterations;
+      if (solved && f1 <= bound) {
+        break;
+      }
+    }
+  }
+
+  return {theta, lambda, f1, iterations, convergence, 0};
+}
+
+// Mean of x: g(theta) = x - 1 * theta'.
+class MEAN_MODEL {
+public:
+  explicit MEAN_MODEL(const Eigen::Ref<const Eigen::MatrixXd>& x) : x(x) {}
+
+  Eigen::MatrixXd g(const Eigen::Ref<const Eigen::VectorXd>& theta) const {
+    return x.rowwise() - theta.transpose();
+  }
+  Eigen::VectorXd theta_gradient(const Eigen::Ref<const Eigen::VectorXd>&,
+                                 const Eigen::Ref<const Eigen::VectorXd>& lambda,
+                                 const Eigen::Ref<const Eigen::VectorXd>& dplog) const {
+    return -dplog.sum() * lambda;
+  }
+  double step_size() const {return 1.0 / x.rows();}
+  Eigen::MatrixXd range() const {
+    Eigen::MatrixXd range(x.cols(), 2);
+    range.col(0) = x.colwise().minCoeff().transpose();
+    range.col(1) = x.colwise().maxCoeff().transpose();
+    return range;
+  }
+  void kkt_blocks(const Eigen::Ref<const Eigen::VectorXd>&,
+                  const Eigen::Ref<const Eigen::VectorXd>& lambda,
+                  const Eigen::Ref<const Eigen::MatrixXd>& g,
+                  const Eigen::Ref<const Eigen::VectorXd>& dplog,
+                  const Eigen::Ref<const Eigen::VectorXd>& neg_d2plog,
+                  Eigen::MatrixXd& H_tl,
+                  Eigen::MatrixXd& H_tt) const {
+    H_tl = lambda * (g.transpose() * neg_d2plog).transpose();
+    H_tl.diagonal().array() -= dplog.sum();
+    H_tt = -neg_d2plog.sum() * lambda * lambda.transpose();
+  }
+  void kkt_row(const int,
+               const Eigen::Ref<const Eigen::VectorXd>&,
+               const Eigen::Ref<const Eigen::VectorXd>& lambda,
+               const Eigen::Ref<const Eigen::VectorXd>& g_i,
+               const double dplog,
+               const double neg_d2plog,
+               Eigen::VectorXd& gradient,
+               Eigen::MatrixXd& H_tl,
+               Eigen::MatrixXd& H_tt) const {
+    gradient = -dplog * lambda;
+    H_tl = neg_d2plog * lambda * g_i.transpose();
+    H_tl.diagonal().array() -= dplog;
+    H_tt = -neg_d2plog * lambda * lambda.transpose();
+  }
+
+private:
+  const Eigen::Ref<const Eigen::MatrixXd> x;
+};
+#endif
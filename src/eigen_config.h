@@ -1,6 +1,8 @@
 #ifndef EIGEN_CONFIG_H_
 #define EIGEN_CONFIG_H_
 
+// Eigen's own threading stays off; large single solves are split over row
+// blocks by the policy in scheduler.h(solve_threads)
 #define EIGEN_DONT_PARALLELIZE
 //#define EIGEN_NO_DEBUG
 #endif
@@ -1,25 +1,283 @@
 #include "utils_ibd.h"
+#include "constrained_EL.h"
+#include "EL_BATCH.h"
+#include "scheduler.h"
+#include "trace.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace {
+// Calls f(x, c) with x and c mapped from R memory. Numeric matrices are
+// mapped as they are(other storage modes are coerced first) and dgCMatrix
+// objects as sparse matrices. A sparse x with a dense c is densified since
+// g = x - c * diag(theta) is dense anyway.
+template <typename F>
+Rcpp::List with_ibd_data(SEXP x, SEXP c, const F& f) {
+  if (is_sparse(c)) {
+    const Eigen::MappedSparseMatrix<double> c_map(
+        Rcpp::as<Eigen::MappedSparseMatrix<double>>(c));
+    if (is_sparse(x)) {
+      const Eigen::MappedSparseMatrix<double> x_map(
+          Rcpp::as<Eigen::MappedSparseMatrix<double>>(x));
+      return f(SparseRef(x_map), SparseRef(c_map));
+    }
+    Rcpp::NumericMatrix x_r(x);
+    const Eigen::Map<Eigen::MatrixXd> x_map(x_r.begin(), x_r.nrow(), x_r.ncol());
+    return f(Eigen::Ref<const Eigen::MatrixXd>(x_map), SparseRef(c_map));
+  }
+  Rcpp::NumericMatrix c_r(c);
+  const Eigen::Map<Eigen::MatrixXd> c_map(c_r.begin(), c_r.nrow(), c_r.ncol());
+  if (is_sparse(x)) {
+    const Eigen::MatrixXd x_dense(
+        Rcpp::as<Eigen::MappedSparseMatrix<double>>(x));
+    return f(Eigen::Ref<const Eigen::MatrixXd>(x_dense),
+             Eigen::Ref<const Eigen::MatrixXd>(c_map));
+  }
+  Rcpp::NumericMatrix x_r(x);
+  const Eigen::Map<Eigen::MatrixXd> x_map(x_r.begin(), x_r.nrow(), x_r.ncol());
+  return f(Eigen::Ref<const Eigen::MatrixXd>(x_map),
+           Eigen::Ref<const Eigen::MatrixXd>(c_map));
+}
+
+struct TEST_IBD {
+  const Eigen::Map<Eigen::MatrixXd>& lhs;
+  const Eigen::Map<Eigen::VectorXd>& rhs;
+  const bool approx_lambda;
+  const int maxit;
+  const double abstol;
+
+  template <typename X, typename C>
+  Rcpp::List operator()(const X& x, const C& c) const {
+    const Eigen::VectorXd theta0 = col_sums(x).cwiseQuotient(col_sums(c));
+    // the approximation is implemented for dense data only
+    minEL result = approx_lambda ?
+      test_ibd_EL(theta0, as_dense(x), as_dense(c), lhs, rhs, true, maxit,
+                  abstol) :
+      test_ibd_EL(theta0, x, c, lhs, rhs, maxit, abstol);
+    if (std::isinf(result.nlogLR)) {
+      Rcpp::warning("Convex hull constraint not satisfied. nlogLR is set to Inf.");
+    }
+    return Rcpp::List::create(
+      Rcpp::Named("theta") = result.theta,
+      Rcpp::Named("lambda") = result.lambda,
+      Rcpp::Named("nlogLR") = result.nlogLR,
+      Rcpp::Named("iterations") = result.iterations,
+      Rcpp::Named("convergence") = result.convergence,
+      Rcpp::Named("refreshes") = result.refreshes);
+  }
+};
+
+struct TEST_IBD_JACKKNIFE {
+  const Eigen::Map<Eigen::MatrixXd>& lhs;
+  const Eigen::Map<Eigen::VectorXd>& rhs;
+  const int maxit;
+  const double abstol;
+  const int steps;
+  const int ncores;
+
+  template <typename X, typename C>
+  Rcpp::List operator()(const X& x, const C& c) const {
+    const int n = x.rows();
+    const int p = x.cols();
+    const minEL full =
+      test_ibd_EL(col_sums(x).cwiseQuotient(col_sums(c)), x, c, lhs, rhs,
+                  maxit, abstol);
+    jackknifeEL loo{Eigen::MatrixXd::Zero(n, p), Eigen::MatrixXd::Zero(n, p),
+                    Eigen::VectorXd::Constant(
+                      n, std::numeric_limits<double>::infinity()),
+                    std::vector<char>(n, 0)};
+    // no subset has 0 in its convex hull if the full data does not
+    if (std::isinf(full.nlogLR)) {
+      Rcpp::warning("Convex hull constraint not satisfied. nlogLR is set to Inf.");
+    } else {
+      loo = jackknife_EL(IBD_MODEL<X, C>(x, c), full, lhs, rhs, steps,
+                         ncores);
+    }
+    Rcpp::LogicalVector updated(n);
+    for (int i = 0; i < n; ++i) {
+      updated[i] = !loo.failed[i] && !std::isinf(full.nlogLR);
+      if (loo.failed[i]) {
+        const minEL result = test_ibd_EL(drop_row(as_dense(x), i),
+                                         drop_row(as_dense(c), i), lhs, rhs,
+                                         maxit, abstol);
+        loo.theta.row(i) = result.theta;
+        loo.lambda.row(i) = result.lambda;
+        loo.nlogLR[i] = result.nlogLR;
+      }
+    }
+    return Rcpp::List::create(
+      Rcpp::Named("nlogLR") = loo.nlogLR,
+      Rcpp::Named("theta") = loo.theta,
+      Rcpp::Named("lambda") = loo.lambda,
+      Rcpp::Named("updated") = updated,
+      Rcpp::Named("full") = Rcpp::List::create(
+        Rcpp::Named("theta") = full.theta,
+        Rcpp::Named("lambda") = full.lambda,
+        Rcpp::Named("nlogLR") = full.nlogLR));
+  }
+};
+
+namespace {
+// "mc"(i.i.d. draws) or "qmc"(randomized quasi-Monte Carlo) for PB
+bool qmc_sampler(const std::string& sampler) {
+  if (sampler != "mc" && sampler != "qmc") {
+    Rcpp::warning("sampler '%s' is not supported. Using 'mc' as default.",
+                  sampler);
+  }
+  return sampler == "qmc";
+}
+
+// hexadecimal form of a fingerprint; R has no unsigned 64-bit integers
+std::string hex(const std::uint64_t key) {
+  char buffer[17];
+  std::snprintf(buffer, sizeof(buffer), "%016llx",
+                static_cast<unsigned long long>(key));
+  return buffer;
+}
+
+// fingerprint of the state of R's random number generator at the start of
+// the call(.Random.seed is written back only on return); "" before the
+// generator is first used
+std::string rng_fingerprint() {
+  const SEXP state = Rcpp::Environment::global_env().get(".Random.seed");
+  if (Rf_isNull(state)) {
+    return "";
+  }
+  Rcpp::IntegerVector seed(state);
+  return hex(fingerprint(seed.begin(), sizeof(int) * seed.size()));
+}
+}
+
+struct PAIRWISE_IBD {
+  const bool interval;
+  const int B;
+  const double level;
+  const std::string& method;
+  const bool correction;
+  const bool approx_lambda;
+  const int ncores;
+  const int maxit;
+  const double abstol;
+  const std::string& checkpoint;
+  const bool resume;
+  const bool screen;
+  const double margin;
+  const SEXP bootstrap;
+  const bool keep_bootstrap;
+  const bool qmc;
+
+  template <typename X, typename C>
+  Rcpp::List operator()(const X& x, const C& c) const;
+};
+
+struct MULTITEST_IBD {
+  const std::vector<Eigen::MatrixXd>& lhs;
+  const std::vector<Eigen::VectorXd>& rhs;
+  const int B;
+  const double level;
+  const std::string& method;
+  const bool correction;
+  const bool approx_lambda;
+  const int ncores;
+  const int maxit;
+  const double abstol;
+  const std::string& checkpoint;
+  const bool resume;
+  const bool screen;
+  const double margin;
+  const bool qmc;
+
+  template <typename X, typename C>
+  Rcpp::List operator()(const X& x, const C& c) const;
+};
+
+// hypotheses as a list of (lhs, rhs) lists or hypothesis matrices, or as a
+// three-dimensional array of hypothesis matrices; rhs defaults to zero
+void read_hypotheses(SEXP hypotheses,
+                     std::vector<Eigen::MatrixXd>& lhs,
+                     std::vector<Eigen::VectorXd>& rhs) {
+  if (Rf_isArray(hypotheses) && Rf_length(Rf_getAttrib(hypotheses, R_DimSymbol)) == 3) {
+    Rcpp::NumericVector a(hypotheses);
+    const Rcpp::IntegerVector dim = a.attr("dim");
+    for (int k = 0; k < dim[2]; ++k) {
+      lhs.push_back(Eigen::Map<const Eigen::MatrixXd>(
+          a.begin() + static_cast<R_xlen_t>(k) * dim[0] * dim[1],
+          dim[0], dim[1]));
+      rhs.push_back(Eigen::VectorXd::Zero(dim[0]));
+    }
+  } else if (Rf_isNewList(hypotheses)) {
+    const Rcpp::List list(hypotheses);
+    for (int k = 0; k < list.size(); ++k) {
+      SEXP h = list[k];
+      SEXP l = h;
+      if (Rf_isNewList(h)) {
+        Rcpp::List pair(h);
+        if (!pair.containsElementNamed("lhs")) {
+          Rcpp::stop("Hypothesis %i has no lhs.", k + 1);
+        }
+        l = pair["lhs"];
+      }
+      // a vector is a single row
+      Rcpp::NumericVector v(l);
+      Eigen::MatrixXd L = Rf_isMatrix(l) ?
+        Rcpp::as<Eigen::MatrixXd>(v) :
+        Eigen::MatrixXd(Eigen::Map<const Eigen::RowVectorXd>(v.begin(), v.size()));
+      Eigen::VectorXd r = Eigen::VectorXd::Zero(L.rows());
+      if (Rf_isNewList(h)) {
+        Rcpp::List pair(h);
+        if (pair.containsElementNamed("rhs")) {
+          r = Rcpp::as<Eigen::VectorXd>(pair["rhs"]);
+        }
+      }
+      lhs.push_back(std::move(L));
+      rhs.push_back(std::move(r));
+    }
+  } else {
+    Rcpp::stop("hypotheses must be a list or a three-dimensional array.");
+  }
+}
+
+struct SCREENING_REPORT {
+  const int B;
+  const double margin;
+  const bool approx_lambda;
+  const int ncores;
+  const int maxit;
+  const double abstol;
+
+  template <typename X, typename C>
+  Rcpp::List operator()(const X& x, const C& c) const;
+};
+}
 
 //' Hypothesis test for incomplete block design
 //'
 //' Hypothesis test for incomplete block design
 //'
-//' @param x a matrix of data .
-//' @param c an incidence matrix.
+//' @param x a matrix of data. Either a numeric matrix or a sparse \code{dgCMatrix}.
+//' @param c an incidence matrix. Either a numeric matrix or a sparse \code{dgCMatrix}.
 //' @param lhs a linear hypothesis matrix.
 //' @param rhs right-hand-side vector for hypothesis, with as many entries as rows in the hypothesis matrix.
-//' @param approx_lambda whether to use the approximation for lambda. Defaults to FALSE.
+//' @param approx_lambda whether to use the approximation for lambda. After the first iterations lambda is linearized in theta and refreshed by an exact solve only when the Newton decrement of its first-order condition exceeds abstol. Defaults to FALSE.
 //' @param maxit an optional value for the maximum number of iterations. Defaults to 1000.
 //' @param abstol an optional value for the absolute convergence tolerance. Defaults to 1e-8.
+//' @param ncores number of cores(threads) to split the inner solves over when the problem is large. Defaults to 1.
+//' @param solver the solver; 'newton'(Newton with step halving) or 'trust'(Levenberg-Marquardt trust region stopped on the Newton decrement, for ill-conditioned problems near the boundary of the convex hull) for the inner problem in lambda, nested in projected gradient descent on theta, or 'joint' for damped Newton steps on the joint optimality conditions in theta, lambda and the multipliers of the hypothesis, which typically converges in a few iterations instead of hundreds. Defaults to 'newton'.
 //' @export
 // [[Rcpp::export]]
-Rcpp::List test_ibd(const Eigen::MatrixXd& x,
-                    const Eigen::MatrixXd& c,
-                    const Eigen::MatrixXd& lhs,
-                    const Eigen::VectorXd& rhs,
+Rcpp::List test_ibd(SEXP x,
+                    SEXP c,
+                    const Eigen::Map<Eigen::MatrixXd>& lhs,
+                    const Eigen::Map<Eigen::VectorXd>& rhs,
                     const bool approx_lambda = false,
                     const int maxit = 1000,
-                    const double abstol = 1e-8) {
+                    const double abstol = 1e-8,
+                    const int ncores = 1,
+                    const std::string solver = "newton") {
   /// initialization ///
   // if (arma::rank(L) != lhs.rows()) {
   //   Rcpp::stop("Hypothesis matrix lhs must have full rank.");
@@ -27,125 +285,741 @@ Rcpp::List test_ibd(const Eigen::MatrixXd& x,
   if (lhs.rows() != rhs.rows()) {
     Rcpp::stop("Dimensions of L and rhs do not match.");
   }
+  SOLVE_THREADS threads(ncores);
+  EL_SOLVER selected(solver);
+  return with_ibd_data(x, c,
+                       TEST_IBD{lhs, rhs, approx_lambda, maxit, abstol});
+}
 
-  minEL result = test_ibd_EL(x, c, lhs, rhs, maxit, abstol);
-
-  return Rcpp::List::create(
-    Rcpp::Named("theta") = result.theta,
-    Rcpp::Named("lambda") = result.lambda,
-    Rcpp::Named("nlogLR") = result.nlogLR,
-    Rcpp::Named("iterations") = result.iterations,
-    Rcpp::Named("convergence") = result.convergence);
+//' Leave-one-out hypothesis test for incomplete block design
+//'
+//' Computes \code{test_ibd(x[-i, ], c[-i, ], lhs, rhs)} for every block i from the solution on all blocks. Deleting a block downdates the factorization of the full problem, and the constrained solution follows from Newton steps on the optimality conditions in theta, lambda and the multipliers of the hypothesis, started at the full solution, instead of n constrained solves of size n - 1. Blocks for which the update does not apply are solved from scratch.
+//'
+//' @param x a matrix of data. Either a numeric matrix or a sparse \code{dgCMatrix}.
+//' @param c an incidence matrix. Either a numeric matrix or a sparse \code{dgCMatrix}.
+//' @param lhs a linear hypothesis matrix.
+//' @param rhs right-hand-side vector for hypothesis, with as many entries as rows in the hypothesis matrix.
+//' @param maxit an optional value for the maximum number of iterations of the full solve. Defaults to 1000.
+//' @param abstol an optional value for the absolute convergence tolerance of the full solve. Defaults to 1e-8.
+//' @param steps number of Newton steps for each deleted block. The first costs O(p^3) and -logLR after the last step is taken from the quadratic model at that step; each further step evaluates the optimality conditions on the remaining blocks at O(np). Defaults to 1.
+//' @param ncores number of cores(threads) to use over the deleted blocks. Defaults to 1.
+//' @return A list with nlogLR, a vector of the n leave-one-out statistics, theta and lambda, n by p matrices whose row i is the solution without block i, updated, FALSE for the blocks solved from scratch, and full, the theta, lambda and nlogLR of all blocks.
+//' @export
+// [[Rcpp::export]]
+Rcpp::List test_ibd_jackknife(SEXP x,
+                              SEXP c,
+                              const Eigen::Map<Eigen::MatrixXd>& lhs,
+                              const Eigen::Map<Eigen::VectorXd>& rhs,
+                              const int maxit = 1000,
+                              const double abstol = 1e-8,
+                              const int steps = 1,
+                              const int ncores = 1) {
+  if (lhs.rows() != rhs.rows()) {
+    Rcpp::stop("Dimensions of L and rhs do not match.");
+  }
+  if (steps < 1) {
+    Rcpp::stop("steps must be positive.");
+  }
+  SOLVE_THREADS threads(ncores);
+  return with_ibd_data(x, c,
+                       TEST_IBD_JACKKNIFE{lhs, rhs, maxit, abstol, steps,
+                                          ncores});
 }
 
 //' Pairwise comparison for Incomplete Block Design
 //'
 //' Pairwise comparison for Incomplete Block Design
 //'
-//' @param x a matrix of data .
-//' @param c an incidence matrix.
+//' @param x a matrix of data. Either a numeric matrix or a sparse \code{dgCMatrix}.
+//' @param c an incidence matrix. Either a numeric matrix or a sparse \code{dgCMatrix}.
 //' @param interval whether to compute interval. Defaults to FALSE.
 //' @param B number of bootstrap replicates.
 //' @param level level.
 //' @param method the method to be used; either 'PB' or 'NB' is supported. Defaults to 'PB'.
 //' @param correction whether to use blocked bootstrap. Defaults to FALSE.
 //' @param approx_lambda whether to use the approximation for lambda. Defaults to FALSE.
-//' @param ncores number of cores(threads) to use. Defaults to 1.
+//' @param ncores number of cores(threads) to use for the bootstrap and the pairwise tests. Defaults to 1.
 //' @param maxit an optional value for the maximum number of iterations. Defaults to 1000.
 //' @param abstol an optional value for the absolute convergence tolerance. Defaults to 1e-8.
+//' @param checkpoint an optional path to a checkpoint file for bootstrap replicates. Defaults to "" (no checkpoint).
+//' @param resume whether to resume from the replicates in \code{checkpoint}. The random seed must be the same as in the interrupted run. Defaults to FALSE.
+//' @param screen whether to screen the pairs of each NB bootstrap replicate by Euclidean likelihood and solve the exact problem only for pairs that may attain the maximum. Defaults to FALSE.
+//' @param margin relative safety margin for \code{screen}. A pair is solved if its Euclidean statistic times 1 + margin is at least the current maximum. Defaults to 0.5.
+//' @param trace an optional path for a timeline of the threads(replicates, pairs, inner solves, step halving and warnings) in Chrome trace-event JSON, viewable in chrome://tracing or Perfetto. Defaults to "" (no tracing).
+//' @param solver the solver; 'newton'(Newton with step halving) or 'trust'(Levenberg-Marquardt trust region stopped on the Newton decrement, for ill-conditioned problems near the boundary of the convex hull) for the inner problem in lambda, nested in projected gradient descent on theta, or 'joint' for damped Newton steps on the joint optimality conditions in theta, lambda and the multipliers of the hypothesis, which typically converges in a few iterations instead of hundreds. Defaults to 'newton'.
+//' @param backend how the many independent tests of the pairwise statistics and the NB bootstrap replicates are executed; either 'scalar'(one test at a time) or 'batch'(lanes of tests advanced in lockstep, with their state in structure-of-arrays form and finished lanes refilled from the queue). 'batch' applies to the exact statistics with solver 'newton'; otherwise tests run one at a time. Defaults to 'scalar'.
+//' @param bootstrap an optional bootstrap distribution, the \code{bootstrap} element of a result computed with \code{keep_bootstrap = TRUE} on the same data. The cutoff for \code{level}(and \code{correction} with 'PB') is then taken from it without resampling, and \code{B}, \code{method} and \code{approx_lambda} are those it was computed with. A distribution computed from different data is refused. Defaults to NULL.
+//' @param keep_bootstrap whether to return the bootstrap distribution as element \code{bootstrap}: an object of class "bootstrap.ibd" with the maximum statistics(sorted within each QMC replicate), the method, approx_lambda, B, the sampler and number of replicates, a fingerprint of the random number generator state(seed) and a fingerprint of the data. Defaults to FALSE.
+//' @param sampler how the 'PB' replicates are drawn; either 'mc'(independent normal draws) or 'qmc'(8 independently scrambled Sobol sequences of B / 8 points each, with the direction numbers of Joe and Kuo, mapped through the normal quantile function and a pivoted Cholesky factor of the covariance estimate). 'qmc' typically reaches a given accuracy of the cutoff with 1 to 3 times fewer replicates, best with B / 8 a power of 2, and the spread of the replicate cutoffs gives its standard error \code{cutoff.se}. Defaults to 'mc'.
 //'
 //' @export
 // [[Rcpp::export]]
-Rcpp::List pairwise_ibd(const Eigen::MatrixXd& x,
-                        const Eigen::MatrixXd& c,
+Rcpp::List pairwise_ibd(SEXP x,
+                        SEXP c,
                         const bool interval = false,
                         const int B = 1e4,
                         const double level = 0.05,
-                        std::string method = "PB",
+                        const std::string method = "PB",
                         const bool correction = false,
                         const bool approx_lambda = false,
                         const int ncores = 1,
                         const int maxit = 1e4,
-                        const double abstol = 1e-8) {
+                        const double abstol = 1e-8,
+                        const std::string checkpoint = "",
+                        const bool resume = false,
+                        const bool screen = false,
+                        const double margin = 0.5,
+                        const std::string trace = "",
+                        const std::string solver = "newton",
+                        const std::string backend = "scalar",
+                        SEXP bootstrap = R_NilValue,
+                        const bool keep_bootstrap = false,
+                        const std::string sampler = "mc") {
   if (level <= 0 || level >= 1) {
     Rcpp::stop("level must be between 0 and 1.");
   }
+  TRACE_SESSION session(trace, ncores);
+  EL_SOLVER selected(solver);
+  EL_BACKEND execution(backend);
+  Rcpp::List result =
+    with_ibd_data(x, c,
+                  PAIRWISE_IBD{interval, B, level, method, correction,
+                               approx_lambda, ncores, maxit, abstol,
+                               checkpoint, resume, screen, margin,
+                               bootstrap, keep_bootstrap,
+                               qmc_sampler(sampler)});
+  session.dump();
+  return result;
+}
+
+template <typename X, typename C>
+Rcpp::List PAIRWISE_IBD::operator()(const X& x, const C& c) const {
+  std::string method = this->method;
+  bool approx_lambda = this->approx_lambda;
   // all pairs
   std::vector<std::array<int, 2>> pairs = all_pairs(x.cols());
+  // bootstrap distribution of the maximum statistic, given or computed
+  const std::string key = hex(fingerprint(c, fingerprint(x)));
+  Eigen::VectorXd distribution;
+  std::string seed;
+  int replicates = 1;
+  if (!Rf_isNull(bootstrap)) {
+    Rcpp::List object(bootstrap);
+    if (!object.inherits("bootstrap.ibd")) {
+      Rcpp::stop("bootstrap must be the bootstrap element of a pairwise_ibd result.");
+    }
+    if (Rcpp::as<std::string>(object["fingerprint"]) != key) {
+      Rcpp::stop("bootstrap distribution was computed from different data.");
+    }
+    distribution = Rcpp::as<Eigen::VectorXd>(object["statistics"]);
+    method = Rcpp::as<std::string>(object["method"]);
+    approx_lambda = Rcpp::as<bool>(object["approx_lambda"]);
+    seed = Rcpp::as<std::string>(object["seed"]);
+    if (object.containsElementNamed("replicates")) {
+      replicates = Rcpp::as<int>(object["replicates"]);
+    }
+  } else {
+    seed = rng_fingerprint();
+    if (method != "PB" && method != "NB") {
+      Rcpp::warning
+      ("method '%s' is not supported. Using 'PB' as default.",
+       method);
+      method = "PB";
+    }
+  }
+  const PAIRWISE_CUTOFF cutoff =
+    pairwise_cutoff(x, c, pairs,
+                    PAIRWISE_BOOTSTRAP{method, B, level, correction,
+                                       approx_lambda, ncores, maxit, abstol,
+                                       checkpoint, resume, screen, margin,
+                                       qmc},
+                    std::move(distribution), replicates);
+  // estimates, statistics(-2logLR) and confidence intervals(optional)
+  const PAIRWISE_TESTS tests =
+    pairwise_tests_ibd(x, c, pairs, cutoff.cutoff, interval, ncores, maxit,
+                       abstol);
+  const int m = pairs.size();
+
+  // result
+  Rcpp::List result;
+  result["estimate"] = tests.estimate;
+  result["statistic"] = tests.statistic;
+  if (interval) {
+    Rcpp::List CI(m);
+    for (int i = 0; i < m; ++i) {
+      CI(i) = Rcpp::NumericVector::create(tests.CI(i, 0), tests.CI(i, 1));
+    }
+    result["CI"] = CI;
+  }
+  result["level"] = level;
+  result["cutoff"] = cutoff.cutoff;
+  if (cutoff.replicates > 1) {
+    result["cutoff.se"] = cutoff.se;
+  }
+  result["method"] = method;
+  result["num.bootstrap"] = cutoff.distribution.size();
+  if (keep_bootstrap) {
+    Rcpp::List object = Rcpp::List::create(
+      Rcpp::Named("statistics") = cutoff.distribution,
+      Rcpp::Named("method") = method,
+      Rcpp::Named("approx_lambda") = approx_lambda,
+      Rcpp::Named("B") = cutoff.distribution.size(),
+      Rcpp::Named("sampler") = cutoff.replicates > 1 ? "qmc" : "mc",
+      Rcpp::Named("replicates") = cutoff.replicates,
+      Rcpp::Named("seed") = seed,
+      Rcpp::Named("fingerprint") = key);
+    object.attr("class") = "bootstrap.ibd";
+    result["bootstrap"] = object;
+  }
+  result.attr("class") = "pairwise.ibd";
+  return result;
+}
+
+namespace {
+// dense copies of the data for a job, which cannot use R memory
+struct COPY_IBD_DATA {
+  Eigen::MatrixXd& x;
+  Eigen::MatrixXd& c;
+
+  template <typename X, typename C>
+  Rcpp::List operator()(const X& x_in, const C& c_in) const {
+    x = as_dense(x_in);
+    c = as_dense(c_in);
+    return Rcpp::List();
+  }
+};
+
+// NB bootstrap of pairwise_ibd on a thread of its own. The data are copied
+// and the resamples drawn on the R thread before the job starts, so the job
+// uses neither R memory nor R's random number generator. The rest of
+// pairwise_ibd runs on the R thread when the job is collected.
+class IBD_JOB {
+public:
+  enum STATE {RUNNING, DONE, CANCELLED, FAILED};
+
+  IBD_JOB(const bool interval,
+          const double level,
+          const bool approx_lambda,
+          const int ncores,
+          const int maxit,
+          const double abstol,
+          const std::string& checkpoint,
+          const bool resume,
+          const bool screen,
+          const double margin,
+          const std::string& solver,
+          const std::string& backend,
+          const bool keep_bootstrap)
+    : interval(interval), level(level), approx_lambda(approx_lambda),
+      ncores(ncores), maxit(maxit), abstol(abstol), checkpoint(checkpoint),
+      resume(resume), screen(screen), margin(margin), solver(solver),
+      backend(backend), keep_bootstrap(keep_bootstrap) {}
+  // a job that is still running is cancelled
+  ~IBD_JOB() {
+    progress.cancelled = true;
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+  IBD_JOB(const IBD_JOB&) = delete;
+  IBD_JOB& operator=(const IBD_JOB&) = delete;
+
+  // copies the data and draws the resamples; on the R thread
+  void start(SEXP x_in, SEXP c_in, const int B, CALL_SETTINGS settings);
+  // waits for the thread; an interrupt cancels the job and is passed on
+  void wait();
+  void cancel() {progress.cancelled = true;}
+  STATE state() const {return static_cast<STATE>(outcome.load());}
+  int completed() const {return progress.completed;}
+  int B() const {return index.cols();}
+  // seconds since the start, until the job stopped
+  double elapsed();
+  // expected seconds to completion from the replicates computed so far; NA
+  // before the first
+  double eta();
+  // issues the warnings of the job and the bootstrap.ibd object of its
+  // distribution; on the R thread after wait
+  Rcpp::List result();
+
+  const bool interval;
+  const double level;
+  const bool approx_lambda;
+  const int ncores;
+  const int maxit;
+  const double abstol;
+  const std::string checkpoint;
+  const bool resume;
+  const bool screen;
+  const double margin;
+  const std::string solver;
+  const std::string backend;
+  const bool keep_bootstrap;
+  Eigen::MatrixXd x;
+  Eigen::MatrixXd c;
+
+private:
+  void run();
+
+  Eigen::ArrayXXi index;
+  std::string seed;
+  BOOTSTRAP_PROGRESS progress;
+  Eigen::VectorXd statistics;
+  std::map<std::string, int> warnings;
+  std::string error;
+  std::atomic<int> outcome{RUNNING};
+  std::chrono::steady_clock::time_point begin;
+  std::chrono::steady_clock::time_point end;
+  std::mutex mutex;
+  std::condition_variable finished;
+  std::thread worker;
+};
+
+void IBD_JOB::start(SEXP x_in, SEXP c_in, const int B, CALL_SETTINGS settings) {
+  with_ibd_data(x_in, c_in, COPY_IBD_DATA{x, c});
+  // as in pairwise_ibd, the seed is that of the generator before the
+  // resamples are drawn
+  seed = rng_fingerprint();
+  index = bootstrap_indices(x.rows(), B);
+  settings.detached = &warnings;
+  begin = std::chrono::steady_clock::now();
+  worker = std::thread([this, settings] {
+    call_settings() = settings;
+    run();
+  });
+}
+
+void IBD_JOB::run() {
+  STATE state = DONE;
+  try {
+    statistics = bootstrap_NB(x, c,
+                              pair_hypotheses(all_pairs(x.cols()), x.cols()),
+                              index, approx_lambda, ncores, maxit, abstol,
+                              approx_lambda ? "NB_apx" : "NB", checkpoint,
+                              resume, screen, margin, &progress);
+    if (progress.completed < B()) {
+      state = CANCELLED;
+    }
+  } catch (const std::exception& e) {
+    error = e.what();
+    state = FAILED;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    end = std::chrono::steady_clock::now();
+    outcome = state;
+  }
+  finished.notify_all();
+}
+
+void IBD_JOB::wait() {
+  while (state() == RUNNING) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      finished.wait_for(lock, std::chrono::milliseconds(100),
+                        [this] {return state() != RUNNING;});
+    }
+    try {
+      Rcpp::checkUserInterrupt();
+    } catch (...) {
+      cancel();
+      worker.join();
+      throw;
+    }
+  }
+  if (worker.joinable()) {
+    worker.join();
+  }
+}
+
+double IBD_JOB::elapsed() {
+  std::lock_guard<std::mutex> lock(mutex);
+  const std::chrono::steady_clock::time_point now =
+    state() == RUNNING ? std::chrono::steady_clock::now() : end;
+  return std::chrono::duration<double>(now - begin).count();
+}
+
+double IBD_JOB::eta() {
+  if (state() != RUNNING) {
+    return 0;
+  }
+  const int done = completed();
+  const int computed = done - progress.resumed;
+  if (computed <= 0) {
+    return NA_REAL;
+  }
+  return elapsed() / computed * (B() - done);
+}
+
+Rcpp::List IBD_JOB::result() {
+  for (const auto& w : warnings) {
+    if (w.second == 1) {
+      Rcpp::warning("%s", w.first);
+    } else {
+      Rcpp::warning("%s (%i times)", w.first, w.second);
+    }
+  }
+  warnings.clear();
+  if (state() == FAILED) {
+    Rcpp::stop("Bootstrap job failed: %s", error);
+  }
+  if (state() == CANCELLED) {
+    Rcpp::stop("Bootstrap job was cancelled after %i of %i replicates.",
+               completed(), B());
+  }
+  Rcpp::List object = Rcpp::List::create(
+    Rcpp::Named("statistics") = sort_statistics(statistics),
+    Rcpp::Named("method") = "NB",
+    Rcpp::Named("approx_lambda") = approx_lambda,
+    Rcpp::Named("B") = B(),
+    Rcpp::Named("sampler") = "mc",
+    Rcpp::Named("replicates") = 1,
+    Rcpp::Named("seed") = seed,
+    Rcpp::Named("fingerprint") = hex(fingerprint(c, fingerprint(x))));
+  object.attr("class") = "bootstrap.ibd";
+  return object;
+}
+
+IBD_JOB* ibd_job(SEXP job) {
+  return Rcpp::XPtr<IBD_JOB>(job).checked_get();
+}
+
+const char* const job_states[] = {"running", "done", "cancelled", "failed"};
+}
+
+//' Asynchronous pairwise comparison for Incomplete Block Design
+//'
+//' Starts the NB bootstrap of \code{pairwise_ibd} on native threads and returns at once, so that the R session stays usable while it runs. The data are copied and the bootstrap samples drawn from the random number generator before returning, so the result is that of \code{pairwise_ibd(method = "NB")} with the same seed. The job is polled with \code{ibd_job_status}, stopped with \code{ibd_job_cancel} and its result obtained with \code{ibd_job_collect}. A job that is garbage collected is cancelled.
+//'
+//' @param x a matrix of data. Either a numeric matrix or a sparse \code{dgCMatrix}.
+//' @param c an incidence matrix. Either a numeric matrix or a sparse \code{dgCMatrix}.
+//' @param interval whether to compute interval. Defaults to FALSE.
+//' @param B number of bootstrap replicates.
+//' @param level level.
+//' @param approx_lambda whether to use the approximation for lambda. Defaults to FALSE.
+//' @param ncores number of cores(threads) to use for the bootstrap and the pairwise tests. Defaults to 1.
+//' @param maxit an optional value for the maximum number of iterations. Defaults to 1000.
+//' @param abstol an optional value for the absolute convergence tolerance. Defaults to 1e-8.
+//' @param checkpoint an optional path to a checkpoint file for bootstrap replicates. Replicates completed before a job is cancelled are kept in it. Defaults to "" (no checkpoint).
+//' @param resume whether to resume from the replicates in \code{checkpoint}. The random seed must be the same as in the interrupted run. Defaults to FALSE.
+//' @param screen whether to screen the pairs of each bootstrap replicate by Euclidean likelihood. Defaults to FALSE.
+//' @param margin relative safety margin for \code{screen}. Defaults to 0.5.
+//' @param solver the solver; 'newton', 'trust' or 'joint', as in \code{pairwise_ibd}. Defaults to 'newton'.
+//' @param backend either 'scalar' or 'batch', as in \code{pairwise_ibd}. Defaults to 'scalar'.
+//' @param keep_bootstrap whether the collected result keeps the bootstrap distribution as element \code{bootstrap}. Defaults to FALSE.
+//' @return An external pointer to the job with S3 class "ibd_job".
+//' @export
+// [[Rcpp::export]]
+SEXP pairwise_ibd_async(SEXP x,
+                        SEXP c,
+                        const bool interval = false,
+                        const int B = 1e4,
+                        const double level = 0.05,
+                        const bool approx_lambda = false,
+                        const int ncores = 1,
+                        const int maxit = 1e4,
+                        const double abstol = 1e-8,
+                        const std::string checkpoint = "",
+                        const bool resume = false,
+                        const bool screen = false,
+                        const double margin = 0.5,
+                        const std::string solver = "newton",
+                        const std::string backend = "scalar",
+                        const bool keep_bootstrap = false) {
+  if (level <= 0 || level >= 1) {
+    Rcpp::stop("level must be between 0 and 1.");
+  }
+  if (B < 1) {
+    Rcpp::stop("B must be positive.");
+  }
+  // the job runs with the solver and backend selected here
+  EL_SOLVER selected(solver);
+  EL_BACKEND execution(backend);
+  Rcpp::XPtr<IBD_JOB> job(
+      new IBD_JOB(interval, level, approx_lambda, ncores, maxit, abstol,
+                  checkpoint, resume, screen, margin, solver, backend,
+                  keep_bootstrap), true);
+  job->start(x, c, B, call_settings());
+  job.attr("class") = "ibd_job";
+  return job;
+}
+
+//' Progress of an asynchronous pairwise comparison
+//'
+//' @param job a job started by \code{pairwise_ibd_async}.
+//' @return A list with the state of the job('running', 'done', 'cancelled' or 'failed'), the number of completed bootstrap replicates and B, the elapsed seconds and the expected seconds to completion eta(NA until a replicate has been computed, 0 once the job has stopped).
+//' @export
+// [[Rcpp::export]]
+Rcpp::List ibd_job_status(SEXP job) {
+  IBD_JOB* j = ibd_job(job);
+  return Rcpp::List::create(
+    Rcpp::Named("state") = job_states[j->state()],
+    Rcpp::Named("completed") = j->completed(),
+    Rcpp::Named("B") = j->B(),
+    Rcpp::Named("elapsed") = j->elapsed(),
+    Rcpp::Named("eta") = j->eta());
+}
+
+//' Cancel an asynchronous pairwise comparison
+//'
+//' Asks the job to stop. Replicates in progress are finished and no others are started, so the job stops within about one replicate; \code{ibd_job_status} shows when it has.
+//'
+//' @param job a job started by \code{pairwise_ibd_async}.
+//' @export
+// [[Rcpp::export]]
+void ibd_job_cancel(SEXP job) {
+  ibd_job(job)->cancel();
+}
+
+//' Result of an asynchronous pairwise comparison
+//'
+//' Waits for the job to finish and returns the result of \code{pairwise_ibd(method = "NB")}; the pairwise statistics and intervals are computed here. Waiting can be interrupted, which cancels the job. Warnings of the bootstrap are issued here. A job that was cancelled or failed is an error.
+//'
+//' @param job a job started by \code{pairwise_ibd_async}.
+//' @return An object of class "pairwise.ibd", as returned by \code{pairwise_ibd}.
+//' @export
+// [[Rcpp::export]]
+Rcpp::List ibd_job_collect(SEXP job) {
+  IBD_JOB* j = ibd_job(job);
+  j->wait();
+  const Rcpp::List bootstrap = j->result();
+  const std::string method = "NB";
+  EL_SOLVER selected(j->solver);
+  EL_BACKEND execution(j->backend);
+  return PAIRWISE_IBD{j->interval, j->B(), j->level, method, false,
+                      j->approx_lambda, j->ncores, j->maxit, j->abstol,
+                      j->checkpoint, j->resume, j->screen, j->margin,
+                      bootstrap, j->keep_bootstrap, false}(
+    Eigen::Ref<const Eigen::MatrixXd>(j->x),
+    Eigen::Ref<const Eigen::MatrixXd>(j->c));
+}
+
+//' Validation of Euclidean screening for the NB bootstrap
+//'
+//' Computes the maximum pairwise statistics of NB bootstrap replicates both by solving all pairs and by Euclidean likelihood screening, on the same bootstrap samples.
+//'
+//' @param x a matrix of data. Either a numeric matrix or a sparse \code{dgCMatrix}.
+//' @param c an incidence matrix. Either a numeric matrix or a sparse \code{dgCMatrix}.
+//' @param B number of bootstrap replicates. Defaults to 200.
+//' @param margin relative safety margin for screening. Defaults to 0.5.
+//' @param approx_lambda whether to use the approximation for lambda. Defaults to FALSE.
+//' @param ncores number of cores(threads) to use. Defaults to 1.
+//' @param maxit an optional value for the maximum number of iterations. Defaults to 1000.
+//' @param abstol an optional value for the absolute convergence tolerance. Defaults to 1e-8.
+//' @return A list with the replicate maxima of the exhaustive and the screened computation, the number of exact solves of each screened replicate, the number of pairs, the largest absolute difference of the maxima, and the proportion of replicates where they agree up to 1e-6.
+//' @export
+// [[Rcpp::export]]
+Rcpp::List screening_report_ibd(SEXP x,
+                                SEXP c,
+                                const int B = 200,
+                                const double margin = 0.5,
+                                const bool approx_lambda = false,
+                                const int ncores = 1,
+                                const int maxit = 1000,
+                                const double abstol = 1e-8) {
+  return with_ibd_data(x, c,
+                       SCREENING_REPORT{B, margin, approx_lambda, ncores,
+                                        maxit, abstol});
+}
+
+template <typename X, typename C>
+Rcpp::List SCREENING_REPORT::operator()(const X& x_in, const C& c_in) const {
+  const Eigen::MatrixXd x = as_dense(x_in);
+  const Eigen::MatrixXd c = as_dense(c_in);
+  const int n = x.rows();
+  const std::vector<Eigen::MatrixXd> lhs =
+    pair_hypotheses(all_pairs(x.cols()), x.cols());
+  const int m = lhs.size();
+  const Eigen::MatrixXd x_centered = centering_ibd(x, c);
+  const Eigen::ArrayXXi bootstrap_index =
+    Eigen::Map<Eigen::ArrayXXi, Eigen::Unaligned>(
+        (Rcpp::as<std::vector<int>>(
+            Rcpp::sample(Rcpp::IntegerVector(Rcpp::seq(0, n - 1)), n * B, true)))
+    .data(), n, B);
+
+  Rcpp::NumericVector exhaustive(B);
+  Rcpp::NumericVector screened(B);
+  Rcpp::IntegerVector solves(B);
+  double* exhaustive_ptr = exhaustive.begin();
+  double* screened_ptr = screened.begin();
+  int* solves_ptr = solves.begin();
+  parallel_pairs(B, 1, 1, ncores, [&](const int b, const int, const int) {
+    const Eigen::MatrixXd x_b =
+      bootstrap_sample(x_centered, bootstrap_index.col(b));
+    const Eigen::MatrixXd c_b = bootstrap_sample(c, bootstrap_index.col(b));
+    const DENSE_IBD_MODEL model(x_b, c_b);
+    double statistic = -std::numeric_limits<double>::infinity();
+    for (int j = 0; j < m; ++j) {
+      statistic =
+        std::max(statistic,
+                 statistic_ibd(model, lhs[j], approx_lambda, maxit, abstol));
+    }
+    exhaustive_ptr[b] = statistic;
+    screened_ptr[b] = screened_max_ibd(model, lhs, margin, approx_lambda,
+                                       maxit, abstol, solves_ptr[b]);
+  });
+  flush_warnings();
+
+  double max_difference = 0;
+  int agree = 0;
+  for (int b = 0; b < B; ++b) {
+    // equal infinite maxima agree
+    const double difference = exhaustive[b] == screened[b] ?
+      0 : std::abs(exhaustive[b] - screened[b]);
+    max_difference = std::max(max_difference, difference);
+    if (difference <= 1e-6 * std::max(1.0, std::abs(exhaustive[b]))) {
+      ++agree;
+    }
+  }
+  return Rcpp::List::create(
+    Rcpp::Named("exhaustive") = exhaustive,
+    Rcpp::Named("screened") = screened,
+    Rcpp::Named("solves") = solves,
+    Rcpp::Named("pairs") = m,
+    Rcpp::Named("max.difference") = max_difference,
+    Rcpp::Named("agreement") = static_cast<double>(agree) / B);
+}
+
+//' Multiple testing for Incomplete Block Design
+//'
+//' Tests a family of linear hypotheses with max-T bootstrap calibration over the whole family. The estimates, the centered data and the covariance estimate are computed once and shared by the hypotheses, which are tested in parallel.
+//'
+//' @param x a matrix of data. Either a numeric matrix or a sparse \code{dgCMatrix}.
+//' @param c an incidence matrix. Either a numeric matrix or a sparse \code{dgCMatrix}.
+//' @param hypotheses a list of hypotheses or a three-dimensional array. Each list element is either a list with a hypothesis matrix \code{lhs} and a right-hand-side vector \code{rhs} or a hypothesis matrix alone. The slices \code{hypotheses[, , k]} of an array are hypothesis matrices. Missing right-hand sides are zero.
+//' @param B number of bootstrap replicates.
+//' @param level level.
+//' @param method the method to be used; either 'PB' or 'NB' is supported. Defaults to 'PB'.
+//' @param correction whether to use blocked bootstrap. Defaults to FALSE.
+//' @param approx_lambda whether to use the approximation for lambda. Defaults to FALSE.
+//' @param ncores number of cores(threads) to use for the bootstrap and the tests. Defaults to 1.
+//' @param maxit an optional value for the maximum number of iterations. Defaults to 1000.
+//' @param abstol an optional value for the absolute convergence tolerance. Defaults to 1e-8.
+//' @param checkpoint an optional path to a checkpoint file for bootstrap replicates. Defaults to "" (no checkpoint).
+//' @param resume whether to resume from the replicates in \code{checkpoint}. Defaults to FALSE.
+//' @param screen whether to screen the hypotheses of each NB bootstrap replicate by Euclidean likelihood. Defaults to FALSE.
+//' @param margin relative safety margin for \code{screen}. Defaults to 0.5.
+//' @param trace an optional path for a timeline of the threads in Chrome trace-event JSON. Defaults to "" (no tracing).
+//' @param solver the solver; 'newton', 'trust' or 'joint'. See \code{pairwise_ibd}. Defaults to 'newton'.
+//' @param sampler how the 'PB' replicates are drawn; either 'mc' or 'qmc'. See \code{pairwise_ibd}. Defaults to 'mc'.
+//' @return A list with the estimates lhs * theta_hat, the statistics(-2logLR), the common cutoff and whether each hypothesis is rejected. With sampler 'qmc', also the standard error of the cutoff, \code{cutoff.se}.
+//' @export
+// [[Rcpp::export]]
+Rcpp::List multitest_ibd(SEXP x,
+                         SEXP c,
+                         SEXP hypotheses,
+                         const int B = 1e4,
+                         const double level = 0.05,
+                         const std::string method = "PB",
+                         const bool correction = false,
+                         const bool approx_lambda = false,
+                         const int ncores = 1,
+                         const int maxit = 1e4,
+                         const double abstol = 1e-8,
+                         const std::string checkpoint = "",
+                         const bool resume = false,
+                         const bool screen = false,
+                         const double margin = 0.5,
+                         const std::string trace = "",
+                         const std::string solver = "newton",
+                         const std::string sampler = "mc") {
+  if (level <= 0 || level >= 1) {
+    Rcpp::stop("level must be between 0 and 1.");
+  }
+  std::vector<Eigen::MatrixXd> lhs;
+  std::vector<Eigen::VectorXd> rhs;
+  read_hypotheses(hypotheses, lhs, rhs);
+  if (lhs.empty()) {
+    Rcpp::stop("hypotheses must not be empty.");
+  }
+  TRACE_SESSION session(trace, ncores);
+  EL_SOLVER selected(solver);
+  Rcpp::List result =
+    with_ibd_data(x, c,
+                  MULTITEST_IBD{lhs, rhs, B, level, method, correction,
+                                approx_lambda, ncores, maxit, abstol,
+                                checkpoint, resume, screen, margin,
+                                qmc_sampler(sampler)});
+  session.dump();
+  return result;
+}
+
+template <typename X, typename C>
+Rcpp::List MULTITEST_IBD::operator()(const X& x, const C& c) const {
+  std::string method = this->method;
+  const int m = lhs.size();   // number of hypotheses
+  for (int k = 0; k < m; ++k) {
+    if (lhs[k].cols() != x.cols()) {
+      Rcpp::stop("Hypothesis %i must have %i columns.", k + 1, x.cols());
+    }
+    if (lhs[k].rows() != rhs[k].size()) {
+      Rcpp::stop("Dimensions of lhs and rhs of hypothesis %i do not match.",
+                 k + 1);
+    }
+  }
   // cutoff value
   double cutoff;
-  if (method == "PB") {
-    cutoff = cutoff_pairwise_PB(x, c, pairs, B, level, correction);
-  } else if (method != "NB") {
+  double cutoff_se = std::numeric_limits<double>::quiet_NaN();
+  if (method != "PB" && method != "NB") {
     Rcpp::warning
     ("method '%s' is not supported. Using 'PB' as default.",
      method);
     method = "PB";
-    cutoff = cutoff_pairwise_PB(x, c, pairs, B, level, correction);
-  } else if (approx_lambda) {
-    cutoff = cutoff_pairwise_NB_approx(x, c, B, level, ncores, maxit, abstol);
+  }
+  if (method == "PB" && qmc) {
+    const Eigen::VectorXd distribution = sort_statistics(
+      bootstrap_PB(cov_ibd(x, c), x.rows(), lhs, B, checkpoint, resume, true),
+      QMC_REPLICATES);
+    const double factor = correction ? correction_PB(x.cols(), x.rows()) : 1;
+    cutoff = factor *
+      sorted_quantile(sort_statistics(distribution), 1 - level);
+    cutoff_se = factor * replicate_se(distribution, QMC_REPLICATES, 1 - level);
+  } else if (method == "PB") {
+    cutoff = cutoff_PB(cov_ibd(x, c), x.rows(), lhs, B, level, correction,
+                       checkpoint, resume);
   } else {
-    cutoff = cutoff_pairwise_NB(x, c, B, level, ncores, maxit, abstol);
+    // resampled blocks are dense
+    cutoff = cutoff_NB(as_dense(x), as_dense(c), lhs, B, level, approx_lambda,
+                       ncores, maxit, abstol, approx_lambda ? "MT_NBa" : "MT_NB",
+                       checkpoint, resume, screen, margin);
   }
   // global minimizer
-  const Eigen::VectorXd theta_hat =
-    x.array().colwise().sum() / c.array().colwise().sum();
-  // number of hypotheses
-  const int m = pairs.size();
-
-
-  // estimates
-  Rcpp::NumericVector estimate(m);
+  const Eigen::VectorXd theta_hat = col_sums(x).cwiseQuotient(col_sums(c));
 
   // statistics(-2logLR)
   Rcpp::NumericVector statistic(m);
-  for (int i = 0; i < m; ++i) {
-    // estimates
-    estimate(i) = theta_hat(pairs[i][0] - 1) - theta_hat(pairs[i][1] - 1);
-    // statistics
-    Eigen::MatrixXd lhs = Eigen::MatrixXd::Zero(1, x.cols());
-    lhs(pairs[i][0] - 1) = 1;
-    lhs(pairs[i][1] - 1) = -1;
-    minEL pairwise_result =
-      test_ibd_EL(theta_hat, x, c, lhs, Eigen::Matrix<double, 1, 1>(0),
-                  maxit, abstol);
-    if (!pairwise_result.convergence) {
-      Rcpp::warning("Test for pair (%i,%i) failed. \n",
-                    pairs[i][0], pairs[i][1]);
+  double* statistic_ptr = statistic.begin();
+  std::vector<char> failed(m, 0);
+  // one work unit per hypothesis
+  parallel_pairs(1, m, 1, ncores, [&](const int, const int k, const int) {
+    TRACE_SPAN span("hypothesis", k);
+    minEL result =
+      test_ibd_EL(theta_hat, x, c, lhs[k], rhs[k], maxit, abstol);
+    failed[k] = !result.convergence;
+    statistic_ptr[k] = 2 * result.nlogLR;
+  });
+  flush_warnings();
+
+  Rcpp::List estimate(m);
+  Rcpp::LogicalVector rejected(m);
+  for (int k = 0; k < m; ++k) {
+    estimate[k] = Eigen::VectorXd(lhs[k] * theta_hat);
+    rejected[k] = statistic[k] > cutoff;
+    if (failed[k]) {
+      Rcpp::warning("Test for hypothesis %i failed. \n", k + 1);
     }
-    statistic(i) = 2 * pairwise_result.nlogLR;
   }
 
-  // // cutoff value
-  // double cutoff;
-  // if (method == "PB") {
-  //   cutoff = cutoff_pairwise_PB(x, c, pairs, B, level, correction);
-  // } else if (approx_lambda) {
-  //   cutoff = cutoff_pairwise_NB_approx(x, c, B, level, ncores, maxit, abstol);
-  // } else {
-  //   cutoff = cutoff_pairwise_NB(x, c, B, level, ncores, maxit, abstol);
-  // }
-
-  // result
   Rcpp::List result;
   result["estimate"] = estimate;
   result["statistic"] = statistic;
-  // confidence interval(optional)
-  if (interval) {
-    Rcpp::List CI(m);
-    for (int i = 0; i < m; ++i) {
-      Eigen::MatrixXd lhs = Eigen::MatrixXd::Zero(1, x.cols());
-      lhs(pairs[i][0] - 1) = 1;
-      lhs(pairs[i][1] - 1) = -1;
-      CI(i) =
-        pair_confidence_interval_ibd(theta_hat, x, c, lhs, estimate(i), cutoff);
-    }
-    result["CI"] = CI;
-  }
+  result["rejected"] = rejected;
   result["level"] = level;
   result["cutoff"] = cutoff;
+  if (method == "PB" && qmc) {
+    result["cutoff.se"] = cutoff_se;
+  }
   result["method"] = method;
   result["num.bootstrap"] = B;
-  result.attr("class") = "pairwise.ibd";
+  result.attr("class") = "multitest.ibd";
   return result;
 }
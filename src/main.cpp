@@ -1,4 +1,7 @@
 #include "EL.h"
+#include "constrained_EL.h"
+#include "EL_STREAM.h"
+#include "scheduler.h"
 #include "utils.h"
 //' Empirical likelihood test for mean
 //'
@@ -8,26 +11,219 @@
 //' @param x a matrix or vector of data. Each row is an observation vector.
 //' @param abstol an optional value for the absolute convergence tolerance. Defaults to 1e-8.
 //' @param maxit an optional value for the maximum number of iterations. Defaults to 50.
+//' @param details whether to return the weights, gradient and hessian. Defaults to FALSE.
+//' @param ncores number of cores(threads) to split the solver over when x is large. Defaults to 1.
+//' @param solver the inner solver for lambda; either 'newton'(Newton with step halving) or 'trust'(Levenberg-Marquardt trust region stopped on the Newton decrement, for ill-conditioned problems near the boundary of the convex hull). Defaults to 'newton'.
+//' @return A list with nlogLR, lambda, iterations and convergence. If theta lies outside the convex hull of x, nlogLR is Inf and convergence is FALSE. If \code{details} is TRUE, also the empirical likelihood weights w and the gradient and hessian of the dual objective minimized over lambda, evaluated at the returned lambda.
 //' @export
 // [[Rcpp::export]]
 Rcpp::List el_mean(const Eigen::Map<Eigen::VectorXd>& theta,
                    const Eigen::Map<Eigen::MatrixXd>& x,
                    const int maxit = 100,
-                   const double abstol = 1e-8) {
-  Eigen::FullPivLU<Eigen::MatrixXd> lu_decomp(x);
+                   const double abstol = 1e-8,
+                   const bool details = false,
+                   const int ncores = 1,
+                   const std::string solver = "newton") {
+  SOLVE_THREADS threads(ncores);
+  EL_SOLVER inner(solver);
+  // rank of x from its p by p cross product instead of a copy of x
+  Eigen::FullPivLU<Eigen::MatrixXd> lu_decomp(x.transpose() * x);
   // // auto rank = Eigen::ColPivHouseholderQR< Eigen::MatrixXd >::rank(x);
   if (lu_decomp.rank() != x.cols()) {
     Rcpp::stop("Design matrix x must have full rank.");
   }
-  // compute EL
-  const EL result = getEL(x.rowwise() - theta.transpose(), maxit, abstol);
+  // compute EL unless theta is outside the convex hull of x
+  const EL result = mean_EL(x, theta, maxit, abstol, details);
+  if (std::isinf(result.nlogLR)) {
+    Rcpp::warning("Convex hull constraint not satisfied. nlogLR is set to Inf.");
+  }
 
   // const EL2 result(x.rowwise() - theta.transpose(), maxit, abstol);
 
-  return Rcpp::List::create(
+  Rcpp::List out = Rcpp::List::create(
     Rcpp::Named("nlogLR") = result.nlogLR,
     Rcpp::Named("lambda") = result.lambda,
     Rcpp::Named("iterations") = result.iterations,
     Rcpp::Named("convergence") = result.convergence);
+  if (details) {
+    out["w"] = result.w;
+    out["grad"] = result.gradient;
+    out["hessian"] = result.hessian;
+  }
+  return out;
+}
+
+
+//' Empirical likelihood test for linear hypotheses on the mean
+//'
+//' Tests lhs * theta = rhs for the mean theta of x. -logLR is minimized over theta subject to the hypothesis by the solver of \code{test_ibd}, with g(theta) = x - theta as the estimating functions.
+//'
+//' @param x a matrix of data. Each row is an observation vector.
+//' @param lhs a linear hypothesis matrix.
+//' @param rhs right-hand-side vector for hypothesis, with as many entries as rows in the hypothesis matrix.
+//' @param maxit an optional value for the maximum number of iterations. Defaults to 1000.
+//' @param abstol an optional value for the absolute convergence tolerance. Defaults to 1e-8.
+//' @param solver the solver; 'newton', 'trust' or 'joint' as in \code{test_ibd}. Defaults to 'newton'.
+//' @return A list with the constrained minimizer theta, lambda, nlogLR, iterations and convergence. If no theta satisfying the hypothesis lies inside the convex hull of x, nlogLR is Inf.
+//' @export
+// [[Rcpp::export]]
+Rcpp::List test_mean(const Eigen::Map<Eigen::MatrixXd>& x,
+                     const Eigen::Map<Eigen::MatrixXd>& lhs,
+                     const Eigen::Map<Eigen::VectorXd>& rhs,
+                     const int maxit = 1000,
+                     const double abstol = 1e-8,
+                     const std::string solver = "newton") {
+  if (lhs.cols() != x.cols()) {
+    Rcpp::stop("Hypothesis matrix lhs must have %i columns.", x.cols());
+  }
+  if (lhs.rows() != rhs.rows()) {
+    Rcpp::stop("Dimensions of L and rhs do not match.");
+  }
+  EL_SOLVER selected(solver);
+  // the initial value is the sample mean
+  const minEL result = constrained_EL(MEAN_MODEL(x), col_sums(x) / x.rows(),
+                                      lhs, rhs, maxit, abstol);
+  if (std::isinf(result.nlogLR)) {
+    Rcpp::warning("Convex hull constraint not satisfied. nlogLR is set to Inf.");
+  }
+  return Rcpp::List::create(
+    Rcpp::Named("theta") = result.theta,
+    Rcpp::Named("lambda") = result.lambda,
+    Rcpp::Named("nlogLR") = result.nlogLR,
+    Rcpp::Named("iterations") = result.iterations,
+    Rcpp::Named("convergence") = result.convergence);
+}
+
+//' Leave-one-out empirical likelihood test for mean
+//'
+//' Computes \code{el_mean(theta, x[-i, ])} for every row i of x from the solution on all rows. Deleting a row downdates the factorization of the full problem, and -logLR follows from Newton steps started at the full solution instead of n solves of size n - 1. Rows for which the update does not apply, e.g. when the solution is near the boundary of the convex hull, are solved from scratch.
+//'
+//' @param theta a vector of parameters to be tested.
+//' @param x a matrix of data. Each row is an observation vector.
+//' @param maxit an optional value for the maximum number of iterations of the full solve. Defaults to 100.
+//' @param abstol an optional value for the absolute convergence tolerance of the full solve. Defaults to 1e-8.
+//' @param steps number of Newton steps for each deleted row. The first costs O(p^3) and -logLR after the last step is taken from the quadratic model at that step; each further step evaluates the gradient on the remaining rows at O(np). Defaults to 1.
+//' @param ncores number of cores(threads) to use over the deleted rows. Defaults to 1.
+//' @return A list with nlogLR, a vector of the n leave-one-out statistics, lambda, an n by p matrix whose row i is lambda for x[-i, ], updated, FALSE for the rows solved from scratch, and full, the nlogLR and lambda of all rows.
+//' @export
+// [[Rcpp::export]]
+Rcpp::List el_mean_jackknife(const Eigen::Map<Eigen::VectorXd>& theta,
+                             const Eigen::Map<Eigen::MatrixXd>& x,
+                             const int maxit = 100,
+                             const double abstol = 1e-8,
+                             const int steps = 1,
+                             const int ncores = 1) {
+  if (theta.size() != x.cols()) {
+    Rcpp::stop("theta must have %i entries.", x.cols());
+  }
+  if (steps < 1) {
+    Rcpp::stop("steps must be positive.");
+  }
+  const int n = x.rows();
+  const int p = x.cols();
+  SOLVE_THREADS threads(ncores);
+  const EL full = mean_EL(x, theta, maxit, abstol);
+  // theta outside the convex hull of x is outside that of every subset
+  if (std::isinf(full.nlogLR)) {
+    Rcpp::warning("Convex hull constraint not satisfied. nlogLR is set to Inf.");
+    const double inf = std::numeric_limits<double>::infinity();
+    return Rcpp::List::create(
+      Rcpp::Named("nlogLR") = Eigen::VectorXd::Constant(n, inf),
+      Rcpp::Named("lambda") = Eigen::MatrixXd::Zero(n, p),
+      Rcpp::Named("updated") = Rcpp::LogicalVector(n, false),
+      Rcpp::Named("full") = Rcpp::List::create(
+        Rcpp::Named("nlogLR") = inf,
+        Rcpp::Named("lambda") = Eigen::VectorXd::Zero(p)));
+  }
+  // theta is fixed by the hypothesis theta = theta
+  const Eigen::MatrixXd identity = Eigen::MatrixXd::Identity(p, p);
+  jackknifeEL loo = jackknife_EL(
+    MEAN_MODEL(x), minEL{theta, full.lambda, full.nlogLR, full.iterations,
+                         full.convergence, 0},
+    identity, theta, steps, ncores);
+  Rcpp::LogicalVector updated(n);
+  for (int i = 0; i < n; ++i) {
+    updated[i] = !loo.failed[i];
+    if (loo.failed[i]) {
+      const EL result = getEL(drop_row(x, i), theta, maxit, abstol);
+      loo.nlogLR[i] = result.nlogLR;
+      loo.lambda.row(i) = result.lambda;
+    }
+  }
+  return Rcpp::List::create(
+    Rcpp::Named("nlogLR") = loo.nlogLR,
+    Rcpp::Named("lambda") = loo.lambda,
+    Rcpp::Named("updated") = updated,
+    Rcpp::Named("full") = Rcpp::List::create(
+      Rcpp::Named("nlogLR") = full.nlogLR,
+      Rcpp::Named("lambda") = full.lambda));
+}
+
+namespace {
+Rcpp::List stream_result(const EL_STREAM& stream) {
+  const EL& result = stream.current();
+  return Rcpp::List::create(
+    Rcpp::Named("nlogLR") = result.nlogLR,
+    Rcpp::Named("lambda") = result.lambda,
+    Rcpp::Named("iterations") = result.iterations,
+    Rcpp::Named("convergence") = result.convergence,
+    Rcpp::Named("n") = stream.rows());
+}
+}
+
+//' Streaming empirical likelihood test for mean
+//'
+//' Creates a stream for the empirical likelihood test of a fixed mean. Rows are added with \code{el_mean_update}, which refines lambda from its previous value instead of solving from scratch.
+//'
+//' @param theta a vector of parameters to be tested.
+//' @param window an optional number of most recent rows to use. Defaults to 0(all rows).
+//' @param maxit an optional value for the maximum number of iterations. Defaults to 100.
+//' @param abstol an optional value for the absolute convergence tolerance. Defaults to 1e-8.
+//' @return An external pointer to the stream with S3 class "el_stream".
+//' @export
+// [[Rcpp::export]]
+SEXP el_mean_stream(const Eigen::Map<Eigen::VectorXd>& theta,
+                    const int window = 0,
+                    const int maxit = 100,
+                    const double abstol = 1e-8) {
+  if (window < 0) {
+    Rcpp::stop("window must be nonnegative.");
+  }
+  Rcpp::XPtr<EL_STREAM> stream(
+      new EL_STREAM(theta, window, maxit, abstol), true);
+  stream.attr("class") = "el_stream";
+  return stream;
 }
 
+//' Update a streaming empirical likelihood test for mean
+//'
+//' Appends rows to a stream created by \code{el_mean_stream}, drops rows outside its window and updates the test.
+//'
+//' @param stream a stream created by \code{el_mean_stream}.
+//' @param x a matrix of new rows. Each row is an observation vector.
+//' @return A list with nlogLR, lambda, iterations, convergence and the number of rows in use n. Until theta lies inside the convex hull of the rows in use and they have full rank, nlogLR is Inf and convergence is FALSE.
+//' @export
+// [[Rcpp::export]]
+Rcpp::List el_mean_update(SEXP stream, const Eigen::Map<Eigen::MatrixXd>& x) {
+  EL_STREAM* s = Rcpp::XPtr<EL_STREAM>(stream).checked_get();
+  if (x.cols() != s->current().lambda.size()) {
+    Rcpp::stop("x must have %i columns.", s->current().lambda.size());
+  }
+  s->update(x);
+  if (std::isinf(s->current().nlogLR)) {
+    Rcpp::warning("Convex hull constraint not satisfied. nlogLR is set to Inf.");
+  }
+  return stream_result(*s);
+}
+
+//' Current state of a streaming empirical likelihood test for mean
+//'
+//' Returns the test for the rows in use without updating the stream.
+//'
+//' @param stream a stream created by \code{el_mean_stream}.
+//' @return A list with nlogLR, lambda, iterations, convergence and the number of rows in use n.
+//' @export
+// [[Rcpp::export]]
+Rcpp::List el_mean_current(SEXP stream) {
+  return stream_result(*Rcpp::XPtr<EL_STREAM>(stream).checked_get());
+}
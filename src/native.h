@@ -0,0 +1,92 @@
+#ifndef EL_NATIVE_H_
+#define EL_NATIVE_H_
+
+// The R API used by the solvers, the bootstrap and the files they write:
+// errors, warnings and random numbers. Built with -DELMULTTEST_STANDALONE
+// (the command-line driver in standalone/), the same calls run without R:
+// errors are thrown as std::runtime_error, warnings are printed to stderr and
+// random numbers come from a 64-bit Mersenne Twister seeded by set_seed.
+// Under R, errors and warnings on the threads of an asynchronous job are
+// handled as set out in CALL_SETTINGS; random numbers are drawn on the R
+// thread only.
+#include "eigen_config.h"
+#include "settings.h"
+#ifdef ELMULTTEST_STANDALONE
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#else
+#include <RcppEigen.h>
+#endif
+
+namespace native {
+#ifdef ELMULTTEST_STANDALONE
+namespace detail {
+inline const char* arg(const std::string& x) {return x.c_str();}
+template <typename T>
+const T& arg(const T& x) {return x;}
+
+// printf-style formatting with std::string arguments, as tinyformat in Rcpp
+template <typename... A>
+std::string format(const char* fmt, const A&... args) {
+  const int size = std::snprintf(nullptr, 0, fmt, arg(args)...);
+  if (size <= 0) {
+    return std::string();
+  }
+  std::vector<char> buffer(size + 1);
+  std::snprintf(buffer.data(), buffer.size(), fmt, arg(args)...);
+  return std::string(buffer.data(), size);
+}
+}
+
+template <typename... A>
+[[noreturn]] void stop(const char* fmt, const A&... args) {
+  throw std::runtime_error(detail::format(fmt, args...));
+}
+template <typename... A>
+void warning(const char* fmt, const A&... args) {
+  std::fprintf(stderr, "Warning: %s\n", detail::format(fmt, args...).c_str());
+}
+
+void set_seed(const std::uint64_t seed);
+// uniform on (0, 1)
+double unif_rand();
+double norm_rand();
+// standard normal quantile(Wichura's AS 241, as qnorm in R)
+double qnorm(const double p);
+// size draws from 0, ..., n - 1 with replacement
+std::vector<int> sample_index(const int n, const int size);
+#else
+template <typename... A>
+[[noreturn]] void stop(const char* fmt, const A&... args) {
+  if (call_settings().detached) {
+    throw std::runtime_error(tfm::format(fmt, args...));
+  }
+  Rcpp::stop(fmt, args...);
+}
+template <typename... A>
+void warning(const char* fmt, const A&... args) {
+  if (std::map<std::string, int>* const detached = call_settings().detached) {
+    const std::string message = tfm::format(fmt, args...);
+    #pragma omp critical(el_warning)
+    ++(*detached)[message];
+    return;
+  }
+  Rcpp::warning(fmt, args...);
+}
+
+inline double unif_rand() {return ::unif_rand();}
+inline double norm_rand() {return R::rnorm(0, 1.0);}
+inline double qnorm(const double p) {return R::qnorm(p, 0, 1, 1, 0);}
+inline std::vector<int> sample_index(const int n, const int size) {
+  return Rcpp::as<std::vector<int>>(
+    Rcpp::sample(Rcpp::IntegerVector(Rcpp::seq(0, n - 1)), size, true));
+}
+#endif
+}
+#endif
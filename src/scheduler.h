@@ -0,0 +1,154 @@
+#ifndef EL_SCHEDULER_H_
+#define EL_SCHEDULER_H_
+
+#include "settings.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+// OpenMP runtime queries. Without OpenMP the pragmas are ignored and the
+// runtime is not linked, so these fall back to a single serial thread.
+inline int thread_number() {
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+inline bool in_parallel() {
+#ifdef _OPENMP
+  return omp_in_parallel();
+#else
+  return false;
+#endif
+}
+
+inline int active_level() {
+#ifdef _OPENMP
+  return omp_get_active_level();
+#else
+  return 0;
+#endif
+}
+
+// Number of pairs per work unit. Whole replicates are used while there are
+// enough of them to balance the threads; otherwise replicates are split so
+// that each thread gets about 64 units to steal from.
+inline int pair_block_size(const int B, const int m, const int ncores) {
+  const long units = 64L * std::max(ncores, 1);
+  if (ncores <= 1 || static_cast<long>(B) >= units) {
+    return std::max(m, 1);
+  }
+  const long size = (static_cast<long>(B) * m + units - 1) / units;
+  return static_cast<int>(std::max(1L, std::min<long>(size, m)));
+}
+
+// Runs task(b, begin, end) for each replicate b in [0, B) and each block
+// [begin, end) of at most block_size pairs out of m. The units are OpenMP
+// tasks, so idle threads take work from the runtime's task pool instead of
+// waiting on a static partition of replicates. The threads run with the
+// CALL_SETTINGS of the caller.
+template <typename Task>
+void parallel_pairs(const int B,
+                    const int m,
+                    const int block_size,
+                    const int ncores,
+                    Task task) {
+  const int size = std::max(block_size, 1);
+  const int blocks = (m + size - 1) / size;
+  const long units = static_cast<long>(B) * blocks;
+  const CALL_SETTINGS settings = call_settings();
+  #pragma omp parallel num_threads(ncores) default(none) shared(task, size, blocks, units, m, settings)
+  {
+    call_settings() = settings;
+    #pragma omp single
+    {
+      // replicate-major order keeps the blocks of a replicate close in time
+      #pragma omp taskloop grainsize(1)
+      for (long u = 0; u < units; ++u) {
+        const int b = static_cast<int>(u / blocks);
+        const int begin = static_cast<int>(u % blocks) * size;
+        task(b, begin, std::min(begin + size, m));
+      }
+    }
+  }
+}
+
+// Threading policy for a single solve on an n by p problem. Inside the
+// outer-level loops above(bootstrap replicates, pairs) each solve is serial;
+// a solve outside them is split over up to solve_thread_limit() threads once
+// n * p^2 pays for the fork/join. The limit is raised by SOLVE_THREADS for
+// the duration of an exported call.
+inline int& solve_thread_limit() {
+  return call_settings().solve_thread_limit;
+}
+
+inline int solve_threads(const long n, const long p) {
+  if (in_parallel() || static_cast<double>(n) * p * p < 1e6) {
+    return 1;
+  }
+  return static_cast<int>(std::max(1L, std::min<long>(solve_thread_limit(), n)));
+}
+
+class SOLVE_THREADS {
+public:
+  explicit SOLVE_THREADS(const int ncores) : previous(solve_thread_limit()) {
+    solve_thread_limit() = std::max(ncores, 1);
+  }
+  ~SOLVE_THREADS() {solve_thread_limit() = previous;}
+
+private:
+  const int previous;
+};
+
+// Runs f(k, begin, end) on the contiguous row ranges [begin, end) of n rows,
+// one per thread. Callers combine partial results indexed by k in order, so
+// results do not depend on scheduling.
+template <typename F>
+void split_rows(const int n, const int threads, F f) {
+  if (threads <= 1) {
+    f(0, 0, n);
+    return;
+  }
+  const int chunk = (n + threads - 1) / threads;
+  #pragma omp parallel for num_threads(threads) schedule(static, 1)
+  for (int k = 0; k < threads; ++k) {
+    f(k, std::min(k * chunk, n), std::min((k + 1) * chunk, n));
+  }
+}
+
+// Per-replicate maximum over the blocks of a replicate.
+class REPLICATE_MAX {
+public:
+  REPLICATE_MAX(const int B, const int blocks)
+    : maximum(B, -std::numeric_limits<double>::infinity()),
+      remaining(B, blocks) {}
+
+  // Returns true when the last block of replicate b has been reduced.
+  bool update(const int b, const double value) {
+    bool complete;
+    #pragma omp critical(replicate_max)
+    {
+      maximum[b] = std::max(maximum[b], value);
+      complete = --remaining[b] == 0;
+    }
+    return complete;
+  }
+  double operator[](const int b) const {return maximum[b];}
+  // maximum over the blocks reduced so far; safe to call from worker threads
+  double current(const int b) {
+    double value;
+    #pragma omp critical(replicate_max)
+    value = maximum[b];
+    return value;
+  }
+
+private:
+  std::vector<double> maximum;
+  std::vector<int> remaining;
+};
+#endif
@@ -0,0 +1,42 @@
+#ifndef EL_SETTINGS_H_
+#define EL_SETTINGS_H_
+
+#include <map>
+#include <string>
+
+// Inner solver for lambda: Newton with step halving(NEWTON) or Newton damped
+// by a Levenberg-Marquardt trust region, stopped on the Newton decrement
+// (TRUST_REGION). The damped steps stay bounded when the Gram matrix is
+// ill-conditioned or the solution is near the boundary of the hull, where
+// step halving takes many evaluations. JOINT replaces the nested projected
+// gradient descent of test_ibd_EL by Newton steps on the joint KKT system in
+// theta, lambda and the constraint multipliers; its initial lambda is solved
+// by NEWTON. Selected by EL_SOLVER for the duration of an exported call.
+enum EL_METHOD {NEWTON, TRUST_REGION, JOINT};
+
+// Backend for the many independent test_ibd_EL problems of a bootstrap
+// replicate or of the pairwise statistics: one scalar solve per hypothesis
+// (SCALAR), or lanes of EL_BATCH advanced in lockstep(BATCH). BATCH applies
+// to the exact statistics with the 'newton' solver; other combinations run
+// SCALAR. Selected by EL_BACKEND for the duration of an exported call.
+enum EL_EXECUTION {SCALAR, BATCH};
+
+// Settings of the computation running on a thread. They are thread-local so
+// that asynchronous jobs keep their own while other calls run; the workers
+// of parallel_pairs take those of the thread that starts them.
+struct CALL_SETTINGS {
+  EL_METHOD method = NEWTON;
+  EL_EXECUTION execution = SCALAR;
+  // threads for a single solve outside the parallel loops(SOLVE_THREADS)
+  int solve_thread_limit = 1;
+  // Set on the threads of an asynchronous job, which must not call R:
+  // errors are thrown as std::runtime_error and warnings are counted here,
+  // by message, to be issued on the R thread when the job is collected.
+  std::map<std::string, int>* detached = nullptr;
+};
+
+inline CALL_SETTINGS& call_settings() {
+  static thread_local CALL_SETTINGS settings;
+  return settings;
+}
+#endif
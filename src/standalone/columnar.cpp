@@ -0,0 +1,198 @@
+#include "columnar.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const char columnar_magic[8] = {'E', 'L', 'C', 'O', 'L', '0', '0', '1'};
+
+std::size_t padded(const std::size_t bytes) {
+  return (bytes + 7) / 8 * 8;
+}
+
+// sequential reads from the file image with bounds checks
+class CURSOR {
+public:
+  CURSOR(const char* data, const std::size_t size, const std::string& path)
+    : data(data), size(size), path(path) {}
+
+  const char* take(const std::size_t bytes) {
+    if (bytes > size - position) {
+      native::stop("Columnar file '%s' is truncated.", path);
+    }
+    const char* out = data + position;
+    position += bytes;
+    return out;
+  }
+  template <typename T>
+  T read() {
+    T value;
+    std::memcpy(&value, take(sizeof(T)), sizeof(T));
+    return value;
+  }
+  // count elements of the given size, padded to 8 bytes
+  const char* take(const std::int64_t count, const std::size_t element) {
+    if (count < 0 ||
+        static_cast<std::uint64_t>(count) > (size - position) / element) {
+      native::stop("Columnar file '%s' is truncated.", path);
+    }
+    return take(padded(count * element));
+  }
+
+private:
+  const char* data;
+  const std::size_t size;
+  const std::string& path;
+  std::size_t position = 0;
+};
+}
+
+COLUMNAR_FILE::COLUMNAR_FILE(const std::string& path) {
+#ifndef _WIN32
+  const int fd = open(path.c_str(), O_RDONLY);
+  struct stat info;
+  if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0) {
+    void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      data = static_cast<const char*>(map);
+      size = info.st_size;
+      mapped = true;
+    }
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+#endif
+  // read into memory where mapping is not available
+  if (!mapped) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+      native::stop("Unable to open columnar file '%s'.", path);
+    }
+    std::fseek(file, 0, SEEK_END);
+    const long bytes = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    buffer.resize(bytes > 0 ? (bytes + 7) / 8 : 0);
+    const bool failed = bytes < 0 ||
+      std::fread(buffer.data(), 1, bytes, file) != static_cast<std::size_t>(bytes);
+    std::fclose(file);
+    if (failed) {
+      native::stop("Unable to read columnar file '%s'.", path);
+    }
+    data = reinterpret_cast<const char*>(buffer.data());
+    size = bytes;
+  }
+
+  CURSOR cursor(data, size, path);
+  if (size < 16 || std::memcmp(data, columnar_magic, 8) != 0) {
+    native::stop("'%s' is not a columnar file.", path);
+  }
+  cursor.take(8);
+  const std::int32_t n_sections = cursor.read<std::int32_t>();
+  cursor.read<std::int32_t>();
+  for (int k = 0; k < n_sections; ++k) {
+    SECTION s;
+    const char* name = cursor.take(16);
+    s.name.assign(name, strnlen(name, 16));
+    const std::int32_t storage = cursor.read<std::int32_t>();
+    cursor.read<std::int32_t>();
+    s.rows = cursor.read<std::int64_t>();
+    s.cols = cursor.read<std::int64_t>();
+    s.nnz = cursor.read<std::int64_t>();
+    if (s.rows < 0 || s.cols < 0 || s.nnz < 0 || s.rows > INT32_MAX ||
+        s.cols > INT32_MAX || (storage != 0 && storage != 1)) {
+      native::stop("Section '%s' of columnar file '%s' is malformed.",
+                   s.name, path);
+    }
+    s.sparse = storage == 1;
+    s.outer = nullptr;
+    s.inner = nullptr;
+    if (s.sparse) {
+      s.outer = reinterpret_cast<const std::int32_t*>(
+        cursor.take(s.cols + 1, sizeof(std::int32_t)));
+      s.inner = reinterpret_cast<const std::int32_t*>(
+        cursor.take(s.nnz, sizeof(std::int32_t)));
+      // column pointers must be nondecreasing from 0 to nnz and row indices
+      // within range
+      bool valid = s.outer[0] == 0 && s.outer[s.cols] == s.nnz;
+      for (std::int64_t j = 0; valid && j < s.cols; ++j) {
+        valid = s.outer[j] <= s.outer[j + 1];
+      }
+      for (std::int64_t i = 0; valid && i < s.nnz; ++i) {
+        valid = s.inner[i] >= 0 && s.inner[i] < s.rows;
+      }
+      if (!valid) {
+        native::stop("Section '%s' of columnar file '%s' is malformed.",
+                     s.name, path);
+      }
+    } else if (s.nnz != s.rows * s.cols) {
+      native::stop("Section '%s' of columnar file '%s' is malformed.",
+                   s.name, path);
+    }
+    s.values = reinterpret_cast<const double*>(
+      cursor.take(s.nnz, sizeof(double)));
+    sections.push_back(s);
+  }
+}
+
+COLUMNAR_FILE::~COLUMNAR_FILE() {
+#ifndef _WIN32
+  if (mapped) {
+    munmap(const_cast<char*>(data), size);
+  }
+#endif
+}
+
+const COLUMNAR_FILE::SECTION* COLUMNAR_FILE::find(
+    const std::string& name) const {
+  for (const SECTION& s : sections) {
+    if (s.name == name) {
+      return &s;
+    }
+  }
+  return nullptr;
+}
+
+Eigen::Map<const Eigen::MatrixXd> dense_section(
+    const COLUMNAR_FILE::SECTION& s) {
+  return Eigen::Map<const Eigen::MatrixXd>(s.values, s.rows, s.cols);
+}
+
+Eigen::Map<const Eigen::SparseMatrix<double>> sparse_section(
+    const COLUMNAR_FILE::SECTION& s) {
+  return Eigen::Map<const Eigen::SparseMatrix<double>>(
+    s.rows, s.cols, s.nnz, s.outer, s.inner, s.values);
+}
+
+void write_columnar(
+    const std::string& path,
+    const std::vector<std::pair<std::string, Eigen::MatrixXd>>& sections) {
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    native::stop("Unable to open columnar file '%s'.", path);
+  }
+  const std::int32_t header[2] = {static_cast<std::int32_t>(sections.size()), 0};
+  std::fwrite(columnar_magic, 1, 8, file);
+  std::fwrite(header, sizeof(std::int32_t), 2, file);
+  for (const auto& s : sections) {
+    char name[16] = {};
+    std::memcpy(name, s.first.c_str(), std::min<std::size_t>(s.first.size(), 16));
+    const std::int32_t storage[2] = {0, 0};
+    const std::int64_t dims[3] = {s.second.rows(), s.second.cols(),
+                                  s.second.size()};
+    std::fwrite(name, 1, 16, file);
+    std::fwrite(storage, sizeof(std::int32_t), 2, file);
+    std::fwrite(dims, sizeof(std::int64_t), 3, file);
+    std::fwrite(s.second.data(), sizeof(double), s.second.size(), file);
+  }
+  const bool failed = std::ferror(file) != 0;
+  if (std::fclose(file) != 0 || failed) {
+    native::stop("Unable to write columnar file '%s'.", path);
+  }
+}
@@ -0,0 +1,58 @@
+#ifndef EL_COLUMNAR_H_
+#define EL_COLUMNAR_H_
+
+#include "../native.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Binary columnar file of named matrices, read through a memory map so that
+// dense columns are used in place. Little-endian, every field 8-byte aligned:
+//
+//   header   char magic[8] "ELCOL001"; int32 sections; int32 0
+//   section  char name[16](NUL-padded); int32 storage(0 dense, 1 compressed
+//            sparse column); int32 0; int64 rows; int64 cols; int64 nnz
+//            dense:  rows * cols doubles, column-major(nnz = rows * cols)
+//            sparse: cols + 1 int32 column pointers and nnz int32 row
+//                    indices, each padded with zeros to a multiple of 8
+//                    bytes, then nnz doubles(the slots of a dgCMatrix)
+class COLUMNAR_FILE {
+public:
+  struct SECTION {
+    std::string name;
+    bool sparse;
+    std::int64_t rows;
+    std::int64_t cols;
+    std::int64_t nnz;
+    const std::int32_t* outer;
+    const std::int32_t* inner;
+    const double* values;
+  };
+
+  explicit COLUMNAR_FILE(const std::string& path);
+  ~COLUMNAR_FILE();
+  COLUMNAR_FILE(const COLUMNAR_FILE&) = delete;
+  COLUMNAR_FILE& operator=(const COLUMNAR_FILE&) = delete;
+
+  // nullptr if there is no section of that name
+  const SECTION* find(const std::string& name) const;
+
+private:
+  const char* data = nullptr;
+  std::size_t size = 0;
+  bool mapped = false;
+  std::vector<double> buffer;
+  std::vector<SECTION> sections;
+};
+
+Eigen::Map<const Eigen::MatrixXd> dense_section(
+    const COLUMNAR_FILE::SECTION& s);
+Eigen::Map<const Eigen::SparseMatrix<double>> sparse_section(
+    const COLUMNAR_FILE::SECTION& s);
+
+// writes dense sections in the format above
+void write_columnar(
+    const std::string& path,
+    const std::vector<std::pair<std::string, Eigen::MatrixXd>>& sections);
+#endif
@@ -0,0 +1,356 @@
+// Command-line driver for batch runs of pairwise_ibd without R. Reads x and c
+// from a columnar file(columnar.h), tests all pairs of treatments, computes
+// the bootstrap cutoff and optionally the confidence intervals, and writes
+// the result as JSON or as a columnar file. The solvers and the bootstrap are
+// those of the package, built with R's API replaced by native.h; see the
+// Makefile in this directory.
+//
+// Random numbers come from a Mersenne Twister seeded with --seed instead of
+// R's generator, so bootstrap cutoffs agree with pairwise_ibd in
+// distribution, not draw for draw.
+#include "columnar.h"
+#include "../EL_BATCH.h"
+#include "../trace.h"
+#include "../utils_ibd.h"
+#include <cmath>
+#include <cstdlib>
+#include <initializer_list>
+
+namespace {
+const char* usage =
+  "usage: elmulttest [options] input\n"
+  "\n"
+  "Pairwise tests for the treatment means of an incomplete block design.\n"
+  "input is a columnar file with sections 'x'(data) and 'c'(incidence),\n"
+  "each dense or compressed sparse column.\n"
+  "\n"
+  "  --method PB|NB          bootstrap method(PB)\n"
+  "  --B n                   number of bootstrap replicates(10000)\n"
+  "  --level a               level of the tests(0.05)\n"
+  "  --correction            blocked bootstrap correction of the PB cutoff\n"
+  "  --approx                approximate lambda in the NB bootstrap\n"
+  "  --sampler mc|qmc        PB sampler(mc)\n"
+  "  --interval              simultaneous confidence intervals\n"
+  "  --solver newton|trust|joint\n"
+  "  --backend scalar|batch\n"
+  "  --threads n             number of threads(1)\n"
+  "  --maxit n               maximum number of iterations(10000)\n"
+  "  --abstol tol            absolute convergence tolerance(1e-8)\n"
+  "  --seed s                seed of the random number generator(1)\n"
+  "  --checkpoint path       checkpoint file of the bootstrap\n"
+  "  --resume                resume from the checkpoint file\n"
+  "  --screen                Euclidean screening of the NB replicates\n"
+  "  --margin m              safety margin of the screening(0.5)\n"
+  "  --trace path            Chrome trace-event timeline of the threads\n"
+  "  --format json|binary    output format(json)\n"
+  "  --output path           output file(standard output; json only)\n";
+
+struct OPTIONS {
+  std::string input;
+  std::string method = "PB";
+  int B = 10000;
+  double level = 0.05;
+  bool correction = false;
+  bool approx_lambda = false;
+  std::string sampler = "mc";
+  bool interval = false;
+  std::string solver = "newton";
+  std::string backend = "scalar";
+  int ncores = 1;
+  int maxit = 10000;
+  double abstol = 1e-8;
+  unsigned long long seed = 1;
+  std::string checkpoint;
+  bool resume = false;
+  bool screen = false;
+  double margin = 0.5;
+  std::string trace;
+  std::string format = "json";
+  std::string output;
+};
+
+struct USAGE_ERROR {
+  std::string message;
+};
+
+std::string choice(const std::string& option,
+                   const std::string& value,
+                   std::initializer_list<const char*> values) {
+  for (const char* v : values) {
+    if (value == v) {
+      return value;
+    }
+  }
+  throw USAGE_ERROR{"invalid value '" + value + "' for " + option};
+}
+
+double number(const std::string& option, const std::string& value) {
+  char* end;
+  const double out = std::strtod(value.c_str(), &end);
+  if (value.empty() || *end != '\0' || !std::isfinite(out)) {
+    throw USAGE_ERROR{"invalid value '" + value + "' for " + option};
+  }
+  return out;
+}
+
+int count(const std::string& option, const std::string& value) {
+  const double out = number(option, value);
+  if (out < 1 || out > INT32_MAX || out != std::floor(out)) {
+    throw USAGE_ERROR{"invalid value '" + value + "' for " + option};
+  }
+  return static_cast<int>(out);
+}
+
+OPTIONS parse(const int argc, char** argv) {
+  OPTIONS o;
+  for (int k = 1; k < argc; ++k) {
+    const std::string option = argv[k];
+    if (option.compare(0, 2, "--") != 0) {
+      if (!o.input.empty()) {
+        throw USAGE_ERROR{"more than one input file"};
+      }
+      o.input = option;
+      continue;
+    }
+    // flags
+    if (option == "--correction") {
+      o.correction = true;
+    } else if (option == "--approx") {
+      o.approx_lambda = true;
+    } else if (option == "--interval") {
+      o.interval = true;
+    } else if (option == "--resume") {
+      o.resume = true;
+    } else if (option == "--screen") {
+      o.screen = true;
+    } else {
+      // options with a value
+      if (k + 1 == argc) {
+        throw USAGE_ERROR{"missing value for " + option};
+      }
+      const std::string value = argv[++k];
+      if (option == "--method") {
+        o.method = choice(option, value, {"PB", "NB"});
+      } else if (option == "--B") {
+        o.B = count(option, value);
+      } else if (option == "--level") {
+        o.level = number(option, value);
+        if (o.level <= 0 || o.level >= 1) {
+          throw USAGE_ERROR{"level must be between 0 and 1"};
+        }
+      } else if (option == "--sampler") {
+        o.sampler = choice(option, value, {"mc", "qmc"});
+      } else if (option == "--solver") {
+        o.solver = choice(option, value, {"newton", "trust", "joint"});
+      } else if (option == "--backend") {
+        o.backend = choice(option, value, {"scalar", "batch"});
+      } else if (option == "--threads") {
+        o.ncores = count(option, value);
+      } else if (option == "--maxit") {
+        o.maxit = count(option, value);
+      } else if (option == "--abstol") {
+        o.abstol = number(option, value);
+      } else if (option == "--seed") {
+        o.seed = std::strtoull(value.c_str(), nullptr, 10);
+      } else if (option == "--checkpoint") {
+        o.checkpoint = value;
+      } else if (option == "--margin") {
+        o.margin = number(option, value);
+      } else if (option == "--trace") {
+        o.trace = value;
+      } else if (option == "--format") {
+        o.format = choice(option, value, {"json", "binary"});
+      } else if (option == "--output") {
+        o.output = value;
+      } else {
+        throw USAGE_ERROR{"unknown option " + option};
+      }
+    }
+  }
+  if (o.input.empty()) {
+    throw USAGE_ERROR{"no input file"};
+  }
+  if (o.format == "binary" && o.output.empty()) {
+    throw USAGE_ERROR{"binary output needs --output"};
+  }
+  return o;
+}
+
+struct RESULT {
+  std::vector<std::array<int, 2>> pairs;
+  Eigen::VectorXd estimate;
+  Eigen::VectorXd statistic;
+  // m x 2, lower and upper limits
+  Eigen::MatrixXd CI;
+  double cutoff;
+  double cutoff_se;
+  int num_bootstrap;
+};
+
+// pairwise_ibd(PAIRWISE_IBD in ibd.cpp) without the reuse of a bootstrap
+// distribution
+struct PAIRWISE_IBD {
+  const OPTIONS& o;
+
+  template <typename X, typename C>
+  RESULT operator()(const X& x, const C& c) const {
+    RESULT result;
+    result.pairs = all_pairs(x.cols());
+    const PAIRWISE_CUTOFF cutoff =
+      pairwise_cutoff(x, c, result.pairs,
+                      PAIRWISE_BOOTSTRAP{o.method, o.B, o.level,
+                                         o.correction, o.approx_lambda,
+                                         o.ncores, o.maxit, o.abstol,
+                                         o.checkpoint, o.resume, o.screen,
+                                         o.margin, o.sampler == "qmc"});
+    result.cutoff = cutoff.cutoff;
+    result.cutoff_se = cutoff.se;
+    result.num_bootstrap = cutoff.distribution.size();
+    PAIRWISE_TESTS tests =
+      pairwise_tests_ibd(x, c, result.pairs, result.cutoff, o.interval,
+                         o.ncores, o.maxit, o.abstol);
+    result.estimate = std::move(tests.estimate);
+    result.statistic = std::move(tests.statistic);
+    result.CI = std::move(tests.CI);
+    return result;
+  }
+};
+
+// Calls f(x, c) on the sections of the file, as with_ibd_data in ibd.cpp: a
+// sparse x with a dense c is densified since g is dense anyway.
+template <typename F>
+RESULT with_columnar_data(const COLUMNAR_FILE& file, const F& f) {
+  const COLUMNAR_FILE::SECTION* x = file.find("x");
+  const COLUMNAR_FILE::SECTION* c = file.find("c");
+  if (!x || !c) {
+    native::stop("Input must have sections 'x' and 'c'.");
+  }
+  if (x->rows != c->rows || x->cols != c->cols || x->cols < 2) {
+    native::stop("x and c must have the same dimensions, with at least 2 columns.");
+  }
+  if (c->sparse) {
+    if (x->sparse) {
+      return f(SparseRef(sparse_section(*x)), SparseRef(sparse_section(*c)));
+    }
+    return f(Eigen::Ref<const Eigen::MatrixXd>(dense_section(*x)),
+             SparseRef(sparse_section(*c)));
+  }
+  if (x->sparse) {
+    const Eigen::MatrixXd x_dense(sparse_section(*x));
+    return f(Eigen::Ref<const Eigen::MatrixXd>(x_dense),
+             Eigen::Ref<const Eigen::MatrixXd>(dense_section(*c)));
+  }
+  return f(Eigen::Ref<const Eigen::MatrixXd>(dense_section(*x)),
+           Eigen::Ref<const Eigen::MatrixXd>(dense_section(*c)));
+}
+
+// JSON has no infinity or NaN; they are written as null
+void json_number(std::FILE* out, const double x) {
+  if (std::isfinite(x)) {
+    std::fprintf(out, "%.17g", x);
+  } else {
+    std::fputs("null", out);
+  }
+}
+
+void json_array(std::FILE* out, const char* name, const Eigen::VectorXd& v) {
+  std::fprintf(out, ",\n  \"%s\": [", name);
+  for (int i = 0; i < v.size(); ++i) {
+    std::fputs(i ? ", " : "", out);
+    json_number(out, v(i));
+  }
+  std::fputs("]", out);
+}
+
+void write_json(std::FILE* out, const OPTIONS& o, const RESULT& r) {
+  std::fputs("{\n  \"pairs\": [", out);
+  for (std::size_t i = 0; i < r.pairs.size(); ++i) {
+    std::fprintf(out, "%s[%d, %d]", i ? ", " : "", r.pairs[i][0],
+                 r.pairs[i][1]);
+  }
+  std::fputs("]", out);
+  json_array(out, "estimate", r.estimate);
+  json_array(out, "statistic", r.statistic);
+  if (o.interval) {
+    std::fputs(",\n  \"CI\": [", out);
+    for (int i = 0; i < r.CI.rows(); ++i) {
+      std::fputs(i ? ", [" : "[", out);
+      json_number(out, r.CI(i, 0));
+      std::fputs(", ", out);
+      json_number(out, r.CI(i, 1));
+      std::fputs("]", out);
+    }
+    std::fputs("]", out);
+  }
+  std::fputs(",\n  \"level\": ", out);
+  json_number(out, o.level);
+  std::fputs(",\n  \"cutoff\": ", out);
+  json_number(out, r.cutoff);
+  if (o.method == "PB" && o.sampler == "qmc") {
+    std::fputs(",\n  \"cutoff.se\": ", out);
+    json_number(out, r.cutoff_se);
+  }
+  std::fprintf(out, ",\n  \"method\": \"%s\",\n  \"num.bootstrap\": %d\n}\n",
+               o.method.c_str(), r.num_bootstrap);
+}
+
+// Sections pairs(m x 2), estimate, statistic, CI(m x 2, with --interval) and
+// summary(level, cutoff, cutoff.se(NaN for a single replicate),
+// num.bootstrap and 0 for PB or 1 for NB)
+void write_binary(const std::string& path,
+                  const OPTIONS& o,
+                  const RESULT& r) {
+  const int m = r.pairs.size();
+  Eigen::MatrixXd pairs(m, 2);
+  for (int i = 0; i < m; ++i) {
+    pairs(i, 0) = r.pairs[i][0];
+    pairs(i, 1) = r.pairs[i][1];
+  }
+  Eigen::MatrixXd summary(1, 5);
+  summary << o.level, r.cutoff, r.cutoff_se, r.num_bootstrap,
+             o.method == "NB";
+  std::vector<std::pair<std::string, Eigen::MatrixXd>> sections = {
+    {"pairs", pairs}, {"estimate", r.estimate}, {"statistic", r.statistic}};
+  if (o.interval) {
+    sections.emplace_back("CI", r.CI);
+  }
+  sections.emplace_back("summary", summary);
+  write_columnar(path, sections);
+}
+}
+
+int main(int argc, char** argv) {
+  OPTIONS o;
+  try {
+    o = parse(argc, argv);
+  } catch (const USAGE_ERROR& e) {
+    std::fprintf(stderr, "elmulttest: %s\n\n%s", e.message.c_str(), usage);
+    return 2;
+  }
+  try {
+    native::set_seed(o.seed);
+    const COLUMNAR_FILE file(o.input);
+    TRACE_SESSION session(o.trace, o.ncores);
+    EL_SOLVER selected(o.solver);
+    EL_BACKEND execution(o.backend);
+    const RESULT result = with_columnar_data(file, PAIRWISE_IBD{o});
+    session.dump();
+    if (o.format == "binary") {
+      write_binary(o.output, o, result);
+    } else {
+      std::FILE* out = o.output.empty() ? stdout :
+        std::fopen(o.output.c_str(), "w");
+      if (!out) {
+        native::stop("Unable to open output file '%s'.", o.output);
+      }
+      write_json(out, o, result);
+      if (out != stdout && std::fclose(out) != 0) {
+        native::stop("Unable to write output file '%s'.", o.output);
+      }
+    }
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "Error: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,100 @@
+#include "utils_2sample.h"
+
+namespace {
+// columns of a numeric matrix or elements of a list, without copying
+std::vector<Eigen::Map<const Eigen::VectorXd>> features(
+    SEXP x,
+    std::vector<Rcpp::NumericVector>& storage) {
+  std::vector<Eigen::Map<const Eigen::VectorXd>> out;
+  if (Rf_isNewList(x)) {
+    const Rcpp::List l(x);
+    storage.reserve(l.size());
+    out.reserve(l.size());
+    for (int i = 0; i < l.size(); ++i) {
+      storage.emplace_back(Rcpp::as<Rcpp::NumericVector>(l[i]));
+      out.emplace_back(storage.back().begin(), storage.back().size());
+    }
+  } else if (Rf_isMatrix(x)) {
+    storage.emplace_back(Rcpp::as<Rcpp::NumericVector>(x));
+    const Rcpp::NumericMatrix m(storage.back());
+    out.reserve(m.ncol());
+    for (int j = 0; j < m.ncol(); ++j) {
+      out.emplace_back(storage.back().begin() + j * m.nrow(), m.nrow());
+    }
+  } else {
+    Rcpp::stop("x and y must be numeric matrices or lists of numeric vectors.");
+  }
+  return out;
+}
+}
+
+//' Two sample empirical likelihood test for equal means
+//'
+//' Two sample empirical likelihood test for equal means
+//'
+//' @param x a vector of data for one group.
+//' @param y a vector of data for the other group.
+//' @param maxit an optional value for the maximum number of iterations. Defaults to 1000.
+//' @param abstol an optional value for the absolute convergence tolerance. Defaults to 1e-8.
+//' @export
+// [[Rcpp::export]]
+Rcpp::List el_2sample(const Eigen::Map<Eigen::VectorXd>& x,
+                      const Eigen::Map<Eigen::VectorXd>& y,
+                      const int maxit = 1000,
+                      const double abstol = 1e-8) {
+  const EL_2SAMPLE result = el_2sample_EL(x, y, maxit, abstol);
+  return Rcpp::List::create(
+    Rcpp::Named("par") = result.par,
+    Rcpp::Named("nlogLR") = result.nlogLR,
+    Rcpp::Named("iterations") = result.iterations,
+    Rcpp::Named("convergence") = result.convergence);
+}
+
+//' Batched two sample empirical likelihood tests for equal means
+//'
+//' Two sample empirical likelihood tests for many features at once.
+//'
+//' @param x a numeric matrix whose columns are the features of one group, or a list of numeric vectors.
+//' @param y a numeric matrix or a list for the other group, with as many features as x.
+//' @param ncores number of cores(threads) to use. Defaults to 1.
+//' @param maxit an optional value for the maximum number of iterations. Defaults to 1000.
+//' @param abstol an optional value for the absolute convergence tolerance. Defaults to 1e-8.
+//' @return A list of vectors par, nlogLR, iterations and convergence, one entry per feature.
+//' @export
+// [[Rcpp::export]]
+Rcpp::List el_2sample_batch(SEXP x,
+                            SEXP y,
+                            const int ncores = 1,
+                            const int maxit = 1000,
+                            const double abstol = 1e-8) {
+  std::vector<Rcpp::NumericVector> x_storage, y_storage;
+  const std::vector<Eigen::Map<const Eigen::VectorXd>> xs = features(x, x_storage);
+  const std::vector<Eigen::Map<const Eigen::VectorXd>> ys = features(y, y_storage);
+  if (xs.size() != ys.size()) {
+    Rcpp::stop("x and y must have the same number of features.");
+  }
+  const int m = xs.size();
+
+  Rcpp::NumericVector par(m);
+  Rcpp::NumericVector nlogLR(m);
+  Rcpp::IntegerVector iterations(m);
+  Rcpp::LogicalVector convergence(m);
+  double* par_ptr = par.begin();
+  double* nlogLR_ptr = nlogLR.begin();
+  int* iterations_ptr = iterations.begin();
+  int* convergence_ptr = convergence.begin();
+  #pragma omp parallel for num_threads(ncores) default(none) shared(xs, ys, m, maxit, abstol, par_ptr, nlogLR_ptr, iterations_ptr, convergence_ptr) schedule(dynamic, 16)
+  for (int j = 0; j < m; ++j) {
+    const EL_2SAMPLE result = el_2sample_EL(xs[j], ys[j], maxit, abstol);
+    par_ptr[j] = result.par;
+    nlogLR_ptr[j] = result.nlogLR;
+    iterations_ptr[j] = result.iterations;
+    convergence_ptr[j] = result.convergence;
+  }
+
+  return Rcpp::List::create(
+    Rcpp::Named("par") = par,
+    Rcpp::Named("nlogLR") = nlogLR,
+    Rcpp::Named("iterations") = iterations,
+    Rcpp::Named("convergence") = convergence);
+}
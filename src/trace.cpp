@@ -0,0 +1,125 @@
+#include "trace.h"
+#include "native.h"
+#include "scheduler.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+std::atomic<bool> trace_enabled(false);
+
+namespace {
+struct TRACE_EVENT {
+  const char* name;
+  int id;
+  std::int64_t begin;
+  // -1 for instant events
+  std::int64_t end;
+};
+
+// per-thread buffers, indexed by the OpenMP thread number
+std::vector<std::vector<TRACE_EVENT>> trace_buffers;
+std::vector<long> trace_dropped;
+std::chrono::steady_clock::time_point trace_origin;
+// 32 MB per thread
+const std::size_t trace_capacity = (1 << 20);
+
+void record(const TRACE_EVENT& event) {
+  const std::size_t t = thread_number();
+  // threads of nested teams would share a buffer with their parent
+  if (t >= trace_buffers.size() || active_level() > 1) {
+    return;
+  }
+  if (trace_buffers[t].size() < trace_capacity) {
+    trace_buffers[t].push_back(event);
+  } else {
+    ++trace_dropped[t];
+  }
+}
+}
+
+std::int64_t trace_now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - trace_origin).count();
+}
+
+void trace_record(const char* name,
+                  const int id,
+                  const std::int64_t begin,
+                  const std::int64_t end) {
+  record({name, id, begin, end});
+}
+
+void trace_instant(const char* name) {
+  if (tracing()) {
+    record({name, -1, trace_now(), -1});
+  }
+}
+
+TRACE_SESSION::TRACE_SESSION(const std::string& path, const int threads)
+  : path(path) {
+  if (path.empty()) {
+    return;
+  }
+  trace_buffers.assign(std::max(threads, 1), std::vector<TRACE_EVENT>());
+  for (std::vector<TRACE_EVENT>& buffer : trace_buffers) {
+    buffer.reserve(4096);
+  }
+  trace_dropped.assign(trace_buffers.size(), 0);
+  trace_origin = std::chrono::steady_clock::now();
+  trace_enabled = true;
+}
+
+TRACE_SESSION::~TRACE_SESSION() {
+  if (!path.empty()) {
+    trace_enabled = false;
+    trace_buffers.clear();
+  }
+}
+
+void TRACE_SESSION::dump() {
+  if (path.empty()) {
+    return;
+  }
+  trace_enabled = false;
+  std::FILE* file = std::fopen(path.c_str(), "w");
+  if (!file) {
+    native::stop("Unable to open trace file '%s'.", path);
+  }
+  // timestamps in microseconds
+  std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+  bool first = true;
+  long dropped = 0;
+  for (std::size_t t = 0; t < trace_buffers.size(); ++t) {
+    std::fprintf(file,
+                 "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                 "\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                 first ? "" : ",", static_cast<int>(t), static_cast<int>(t));
+    first = false;
+    for (const TRACE_EVENT& e : trace_buffers[t]) {
+      if (e.end < 0) {
+        std::fprintf(file,
+                     ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,"
+                     "\"tid\":%d,\"ts\":%.3f}",
+                     e.name, static_cast<int>(t), e.begin / 1e3);
+      } else {
+        std::fprintf(file,
+                     ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,"
+                     "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"id\":%d}}",
+                     e.name, static_cast<int>(t), e.begin / 1e3,
+                     (e.end - e.begin) / 1e3, e.id);
+      }
+    }
+    dropped += trace_dropped[t];
+  }
+  std::fputs("\n]}\n", file);
+  const bool failed = std::ferror(file) != 0;
+  std::fclose(file);
+  trace_buffers.clear();
+  if (failed) {
+    native::stop("Unable to write trace file '%s'.", path);
+  }
+  if (dropped > 0) {
+    native::warning("%i trace events dropped after the per-thread buffers filled.",
+                    dropped);
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef EL_TRACE_H_
+#define EL_TRACE_H_
+
+#include "settings.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Opt-in timeline of the parallel loops. While a TRACE_SESSION is open, each
+// thread records spans into its own buffer(no locks or atomics), and the
+// session writes them as Chrome trace-event JSON for chrome://tracing or
+// Perfetto. Without a session a span costs one branch. Asynchronous jobs are
+// not traced: their threads would share the buffers of the session's. The
+// flag is atomic since those threads read it while a session opens or closes.
+extern std::atomic<bool> trace_enabled;
+
+inline bool tracing() {
+  return trace_enabled.load(std::memory_order_relaxed) &&
+    !call_settings().detached;
+}
+
+std::int64_t trace_now();
+void trace_record(const char* name,
+                  const int id,
+                  const std::int64_t begin,
+                  const std::int64_t end);
+// instant event, e.g. a deferred warning
+void trace_instant(const char* name);
+
+class TRACE_SPAN {
+public:
+  explicit TRACE_SPAN(const char* span, const int id = -1)
+    : name(tracing() ? span : nullptr), id(id),
+      begin(name ? trace_now() : 0) {}
+  ~TRACE_SPAN() {
+    if (name) {
+      trace_record(name, id, begin, trace_now());
+    }
+  }
+  TRACE_SPAN(const TRACE_SPAN&) = delete;
+  TRACE_SPAN& operator=(const TRACE_SPAN&) = delete;
+
+private:
+  const char* name;
+  const int id;
+  const std::int64_t begin;
+};
+
+// Enables tracing for threads [0, threads) until destroyed. An empty path
+// disables tracing.
+class TRACE_SESSION {
+public:
+  TRACE_SESSION(const std::string& path, const int threads);
+  ~TRACE_SESSION();
+  // write the recorded events; called from the main thread
+  void dump();
+
+private:
+  const std::string path;
+};
+#endif
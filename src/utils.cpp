@@ -1,4 +1,38 @@
 #include "utils.h"
+#include "scheduler.h"
+#include "trace.h"
+#include <map>
+
+namespace {
+std::map<std::string, int> deferred_warnings;
+}
+
+#ifndef ELMULTTEST_STANDALONE
+bool is_sparse(SEXP x) {
+  return Rf_isS4(x) && Rf_inherits(x, "dgCMatrix");
+}
+#endif
+
+const Eigen::Ref<const Eigen::MatrixXd>& as_dense(
+    const Eigen::Ref<const Eigen::MatrixXd>& x) {
+  return x;
+}
+Eigen::MatrixXd as_dense(const SparseRef& x) {
+  return Eigen::MatrixXd(x);
+}
+
+Eigen::VectorXd col_sums(const Eigen::Ref<const Eigen::MatrixXd>& x) {
+  return x.colwise().sum();
+}
+Eigen::VectorXd col_sums(const SparseRef& x) {
+  Eigen::VectorXd out = Eigen::VectorXd::Zero(x.cols());
+  for (int j = 0; j < x.outerSize(); ++j) {
+    for (SparseRef::InnerIterator it(x, j); it; ++it) {
+      out(j) += it.value();
+    }
+  }
+  return out;
+}
 
 std::vector<std::array<int, 2>> all_pairs(const int p) {
   // initialize a vector of vectors
@@ -30,6 +64,35 @@ void linear_projection_void(
     lhs.transpose() * (lhs * lhs.transpose()).inverse() * (lhs * theta - rhs);
 }
 
+bool range_separated(const Eigen::Ref<const Eigen::MatrixXd>& range,
+                     const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+                     const Eigen::Ref<const Eigen::VectorXd>& rhs) {
+  // each hypothesis must be attainable inside the box of ranges, which is
+  // open except in coordinates with lower == upper(g_j vanishes there)
+  for (int k = 0; k < lhs.rows(); ++k) {
+    double lower = 0;
+    double upper = 0;
+    bool open = false;
+    for (int j = 0; j < lhs.cols(); ++j) {
+      if (lhs(k, j) > 0) {
+        lower += lhs(k, j) * range(j, 0);
+        upper += lhs(k, j) * range(j, 1);
+      } else if (lhs(k, j) < 0) {
+        lower += lhs(k, j) * range(j, 1);
+        upper += lhs(k, j) * range(j, 0);
+      }
+      if (lhs(k, j) != 0 && range(j, 0) < range(j, 1)) {
+        open = true;
+      }
+    }
+    if (rhs(k) < lower || rhs(k) > upper ||
+        (open && (rhs(k) == lower || rhs(k) == upper))) {
+      return true;
+    }
+  }
+  return false;
+}
+
 Eigen::MatrixXd bootstrap_sample(
     const Eigen::Ref<const Eigen::MatrixXd>& x,
     const Eigen::Ref<const Eigen::ArrayXi>& index) {
@@ -39,3 +102,35 @@ Eigen::MatrixXd bootstrap_sample(
   }
   return out;
 }
+
+Eigen::MatrixXd drop_row(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                         const int i) {
+  Eigen::MatrixXd out(x.rows() - 1, x.cols());
+  out << x.topRows(i), x.bottomRows(x.rows() - 1 - i);
+  return out;
+}
+
+void el_warning(const char* message) {
+  trace_instant("warning");
+  // asynchronous jobs keep their own
+  if (!in_parallel() || call_settings().detached) {
+    native::warning(message);
+    return;
+  }
+  #pragma omp critical(el_warning)
+  ++deferred_warnings[message];
+}
+
+void flush_warnings() {
+  if (call_settings().detached) {
+    return;
+  }
+  for (const auto& w : deferred_warnings) {
+    if (w.second == 1) {
+      native::warning(w.first.c_str());
+    } else {
+      native::warning("%s (%i times)", w.first, w.second);
+    }
+  }
+  deferred_warnings.clear();
+}
@@ -1,7 +1,22 @@
 #ifndef EL_UTILS_H_
 #define EL_UTILS_H_
 
-#include <RcppEigen.h>
+#include "native.h"
+
+// sparse matrices(Matrix::dgCMatrix) mapped from R without copying
+typedef Eigen::Ref<const Eigen::SparseMatrix<double>> SparseRef;
+
+#ifndef ELMULTTEST_STANDALONE
+bool is_sparse(SEXP x);
+#endif
+
+// dense matrices as they are, sparse matrices copied
+const Eigen::Ref<const Eigen::MatrixXd>& as_dense(
+    const Eigen::Ref<const Eigen::MatrixXd>& x);
+Eigen::MatrixXd as_dense(const SparseRef& x);
+
+Eigen::VectorXd col_sums(const Eigen::Ref<const Eigen::MatrixXd>& x);
+Eigen::VectorXd col_sums(const SparseRef& x);
 
 std::vector<std::array<int, 2>> all_pairs(const int p);
 
@@ -13,7 +28,20 @@ void linear_projection_void(
     Eigen::Ref<Eigen::VectorXd> theta,
     const Eigen::Ref<const Eigen::MatrixXd>& lhs,
     const Eigen::Ref<const Eigen::VectorXd>& rhs);
+// true if no theta in the box of ranges(p x 2, lower and upper) satisfies
+// lhs * theta = rhs
+bool range_separated(const Eigen::Ref<const Eigen::MatrixXd>& range,
+                     const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+                     const Eigen::Ref<const Eigen::VectorXd>& rhs);
+
+// R API must not be called from worker threads. Warnings raised inside a
+// parallel region are collected and issued later by flush_warnings().
+void el_warning(const char* message);
+void flush_warnings();
 
 Eigen::MatrixXd bootstrap_sample(const Eigen::Ref<const Eigen::MatrixXd>& x,
                                  const Eigen::Ref<const Eigen::ArrayXi>& index);
+// x without row i
+Eigen::MatrixXd drop_row(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                         const int i);
 #endif
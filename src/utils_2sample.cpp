@@ -0,0 +1,185 @@
+#include "utils_2sample.h"
+
+namespace {
+// sums of the pseudo log and its derivatives over 1 + lambda * (x - par)
+struct PLOG_1D {
+  double plog_sum;
+  double dplog_sum;
+  double gradient;
+  double neg_hessian;
+};
+
+PLOG_1D plog_1d(const Eigen::Ref<const Eigen::VectorXd>& x,
+                const double par,
+                const double lambda) {
+  const double n = static_cast<double>(x.size());
+  const double a1 = -std::log(n) - 1.5;
+  const double a2 = 2.0 * n;
+  const double a3 = -0.5 * n * n;
+  PLOG_1D out = {0, 0, 0, 0};
+  for (int i = 0; i < x.size(); ++i) {
+    const double g = x[i] - par;
+    const double arg = 1.0 + lambda * g;
+    double dplog;
+    double sqrt_neg_d2plog;
+    if (n * arg < 1.0) {
+      dplog = a2 + 2 * a3 * arg;
+      sqrt_neg_d2plog = a2 / 2;
+      out.plog_sum += a1 + a2 * arg + a3 * arg * arg;
+    } else {
+      dplog = 1.0 / arg;
+      sqrt_neg_d2plog = 1.0 / arg;
+      out.plog_sum += std::log(arg);
+    }
+    out.dplog_sum += dplog;
+    out.gradient += dplog * g;
+    out.neg_hessian += sqrt_neg_d2plog * sqrt_neg_d2plog * g * g;
+  }
+  return out;
+}
+
+double plog_sum_1d(const Eigen::Ref<const Eigen::VectorXd>& x,
+                   const double par,
+                   const double lambda) {
+  const double n = static_cast<double>(x.size());
+  const double a1 = -std::log(n) - 1.5;
+  const double a2 = 2.0 * n;
+  const double a3 = -0.5 * n * n;
+  double out = 0;
+  for (int i = 0; i < x.size(); ++i) {
+    const double arg = 1.0 + lambda * (x[i] - par);
+    out += n * arg < 1.0 ? a1 + a2 * arg + a3 * arg * arg : std::log(arg);
+  }
+  return out;
+}
+}
+
+double el_lambda_1d(const Eigen::Ref<const Eigen::VectorXd>& x,
+                    const double par,
+                    double lambda,
+                    double& plog_sum,
+                    double& dplog_sum,
+                    bool& convergence,
+                    const int maxit,
+                    const double abstol) {
+  int iterations = 0;
+  convergence = false;
+  while (!convergence && iterations != maxit) {
+    const PLOG_1D eval = plog_1d(x, par, lambda);
+    if (eval.neg_hessian <= 0) {
+      break;
+    }
+    // Newton step
+    double step = eval.gradient / eval.neg_hessian;
+    double f1 = plog_sum_1d(x, par, lambda + step);
+    // step halving to ensure validity
+    while (f1 < eval.plog_sum && std::abs(step) > abstol * abstol) {
+      step /= 2;
+      f1 = plog_sum_1d(x, par, lambda + step);
+    }
+    // no ascent step left: lambda is at the maximum up to rounding
+    if (f1 < eval.plog_sum) {
+      convergence = true;
+      break;
+    }
+    lambda += step;
+    // convergence check
+    if (f1 - eval.plog_sum < abstol) {
+      convergence = true;
+    } else {
+      ++iterations;
+    }
+  }
+  const PLOG_1D eval = plog_1d(x, par, lambda);
+  plog_sum = eval.plog_sum;
+  dplog_sum = eval.dplog_sum;
+  return lambda;
+}
+
+EL_2SAMPLE el_2sample_EL(const Eigen::Ref<const Eigen::VectorXd>& x,
+                         const Eigen::Ref<const Eigen::VectorXd>& y,
+                         const int maxit,
+                         const double abstol) {
+  const double inf = std::numeric_limits<double>::infinity();
+  if (x.size() < 2 || y.size() < 2) {
+    return {NAN, inf, 0, false};
+  }
+  // check convex hull constraint
+  const double xbar = x.mean();
+  const double ybar = y.mean();
+  if (std::min(x.maxCoeff(), y.maxCoeff()) <=
+      std::max(x.minCoeff(), y.minCoeff())) {
+    return {NAN, inf, 0, false};
+  }
+  if (xbar == ybar) {
+    return {xbar, 0, 0, true};
+  }
+  // the common mean lies between the group means and inside both hulls
+  double lb = std::max(std::max(x.minCoeff(), y.minCoeff()),
+                       std::min(xbar, ybar));
+  double ub = std::min(std::min(x.maxCoeff(), y.maxCoeff()),
+                       std::max(xbar, ybar));
+
+  // derivative of -logLR with respect to par, warm starting both lambdas;
+  // converged is whether both lambdas converged
+  double lx = 0;
+  double ly = 0;
+  double fx, fy, dx, dy;
+  bool converged;
+  auto derivative = [&](const double par) {
+    bool cx, cy;
+    lx = el_lambda_1d(x, par, lx, fx, dx, cx, maxit, abstol);
+    ly = el_lambda_1d(y, par, ly, fy, dy, cy, maxit, abstol);
+    converged = cx && cy;
+    return -lx * dx - ly * dy;
+  };
+
+  /// minimization(safeguarded regula falsi on the derivative) ///
+  // An end of the bracket may lie on the boundary of a hull, where lambda
+  // diverges; only the sign of its derivative matters there.
+  const double scale = static_cast<double>(x.size() + y.size());
+  double h_lb = derivative(lb);
+  double h_ub = derivative(ub);
+  double par = lb;
+  int side = 0;
+  int iterations = 0;
+  bool convergence = false;
+  while (!convergence && iterations != maxit) {
+    // secant point, with bisection if it leaves the bracket
+    par = h_ub != h_lb ? (lb * h_ub - ub * h_lb) / (h_ub - h_lb) : lb;
+    if (!(par > lb && par < ub)) {
+      par = (lb + ub) / 2;
+    }
+    const double h = derivative(par);
+    // the bracket is not updated from a derivative at unconverged lambdas
+    if (!converged) {
+      break;
+    }
+    // convergence check
+    if (std::abs(h) / scale < abstol || ub - lb < abstol) {
+      convergence = true;
+      break;
+    }
+    // bracket update(Illinois modification keeps both ends moving)
+    if (h < 0) {
+      lb = par;
+      h_lb = h;
+      if (side == -1) {
+        h_ub /= 2;
+      }
+      side = -1;
+    } else {
+      ub = par;
+      h_ub = h;
+      if (side == 1) {
+        h_lb /= 2;
+      }
+      side = 1;
+    }
+    ++iterations;
+  }
+  if (!convergence) {
+    derivative(par);
+  }
+  return {par, fx + fy, iterations, convergence};
+}
@@ -0,0 +1,30 @@
+#ifndef EL_UTILS_2SAMPLE_H_
+#define EL_UTILS_2SAMPLE_H_
+
+#include "eigen_config.h"
+#include <RcppEigen.h>
+
+struct EL_2SAMPLE {
+  double par;
+  double nlogLR;
+  int iterations;
+  bool convergence;
+};
+
+// EL for the mean of a univariate sample x at par, starting from lambda.
+// Returns lambda and writes the pseudo log sum, the sum of its derivatives
+// and whether lambda converged.
+double el_lambda_1d(const Eigen::Ref<const Eigen::VectorXd>& x,
+                    const double par,
+                    double lambda,
+                    double& plog_sum,
+                    double& dplog_sum,
+                    bool& convergence,
+                    const int maxit = 100,
+                    const double abstol = 1e-8);
+
+EL_2SAMPLE el_2sample_EL(const Eigen::Ref<const Eigen::VectorXd>& x,
+                         const Eigen::Ref<const Eigen::VectorXd>& y,
+                         const int maxit = 1000,
+                         const double abstol = 1e-8);
+#endif
@@ -1,22 +1,160 @@
 #include "utils_ibd.h"
+#include "EL_BATCH.h"
+#include "constrained_EL.h"
+#include "scheduler.h"
+#include "sobol_table.h"
+#include "trace.h"
+#include <memory>
 
 Eigen::MatrixXd g_ibd(const Eigen::Ref<const Eigen::VectorXd>& theta,
                       const Eigen::Ref<const Eigen::MatrixXd>& x,
                       const Eigen::Ref<const Eigen::MatrixXd>& c) {
   return x - (c.array().rowwise() * theta.array().transpose()).matrix();
 }
+Eigen::MatrixXd g_ibd(const Eigen::Ref<const Eigen::VectorXd>& theta,
+                      const Eigen::Ref<const Eigen::MatrixXd>& x,
+                      const SparseRef& c) {
+  // only the nonzero entries of c shift x
+  Eigen::MatrixXd g = x;
+  for (int j = 0; j < c.outerSize(); ++j) {
+    for (SparseRef::InnerIterator it(c, j); it; ++it) {
+      g(it.row(), j) -= it.value() * theta(j);
+    }
+  }
+  return g;
+}
+Eigen::MatrixXd g_ibd(const Eigen::Ref<const Eigen::VectorXd>& theta,
+                      const SparseRef& x,
+                      const SparseRef& c) {
+  Eigen::MatrixXd g = Eigen::MatrixXd::Zero(x.rows(), x.cols());
+  for (int j = 0; j < x.outerSize(); ++j) {
+    for (SparseRef::InnerIterator it(x, j); it; ++it) {
+      g(it.row(), j) = it.value();
+    }
+    for (SparseRef::InnerIterator it(c, j); it; ++it) {
+      g(it.row(), j) -= it.value() * theta(j);
+    }
+  }
+  return g;
+}
 
-Eigen::MatrixXd cov_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
-                        const Eigen::Ref<const Eigen::MatrixXd>& c) {
+namespace {
+template <typename X, typename C>
+Eigen::MatrixXd cov_ibd_impl(const X& x, const C& c) {
   // // estimator(global minimizer)
   // const Eigen::VectorXd theta_hat =
   //   x.array().colwise().sum() / c.array().colwise().sum();
   // estimating function
-  Eigen::MatrixXd g =
-    g_ibd(x.array().colwise().sum() / c.array().colwise().sum(), x, c);
+  Eigen::MatrixXd g = g_ibd(col_sums(x).cwiseQuotient(col_sums(c)), x, c);
   // covariance estimate
   return (g.transpose() * g) / x.rows();
 }
+}
+
+Eigen::MatrixXd cov_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                        const Eigen::Ref<const Eigen::MatrixXd>& c) {
+  return cov_ibd_impl(x, c);
+}
+Eigen::MatrixXd cov_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                        const SparseRef& c) {
+  return cov_ibd_impl(x, c);
+}
+Eigen::MatrixXd cov_ibd(const SparseRef& x, const SparseRef& c) {
+  return cov_ibd_impl(x, c);
+}
+
+namespace {
+// Calls f(x_ij, c_ij) for the rows i of column j, skipping rows where both
+// are structural zeros of sparse matrices.
+template <typename F>
+void column_entries(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                    const Eigen::Ref<const Eigen::MatrixXd>& c,
+                    const int j,
+                    F f) {
+  for (int i = 0; i < x.rows(); ++i) {
+    f(x(i, j), c(i, j));
+  }
+}
+template <typename F>
+void column_entries(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                    const SparseRef& c,
+                    const int j,
+                    F f) {
+  SparseRef::InnerIterator c_it(c, j);
+  for (int i = 0; i < x.rows(); ++i) {
+    if (c_it && c_it.row() == i) {
+      f(x(i, j), c_it.value());
+      ++c_it;
+    } else {
+      f(x(i, j), 0.0);
+    }
+  }
+}
+template <typename F>
+void column_entries(const SparseRef& x,
+                    const SparseRef& c,
+                    const int j,
+                    F f) {
+  // merge of the nonzeros of both columns in row order
+  SparseRef::InnerIterator x_it(x, j);
+  SparseRef::InnerIterator c_it(c, j);
+  while (x_it || c_it) {
+    if (!x_it || (c_it && c_it.row() < x_it.row())) {
+      f(0.0, c_it.value());
+      ++c_it;
+    } else if (!c_it || x_it.row() < c_it.row()) {
+      f(x_it.value(), 0.0);
+      ++x_it;
+    } else {
+      f(x_it.value(), c_it.value());
+      ++x_it;
+      ++c_it;
+    }
+  }
+}
+
+template <typename X, typename C>
+Eigen::MatrixXd theta_range_impl(const X& x, const C& c) {
+  const double inf = std::numeric_limits<double>::infinity();
+  Eigen::MatrixXd range(x.cols(), 2);
+  for (int j = 0; j < x.cols(); ++j) {
+    // g_ij = x_ij - c_ij * theta_j is negative for some i iff
+    // theta_j > lower and positive for some i iff theta_j < upper
+    double lower = inf;
+    double upper = -inf;
+    column_entries(x, c, j, [&](const double x_ij, const double c_ij) {
+      if (c_ij > 0) {
+        lower = std::min(lower, x_ij / c_ij);
+        upper = std::max(upper, x_ij / c_ij);
+      } else if (x_ij < 0) {
+        lower = -inf;
+      } else if (x_ij > 0) {
+        upper = inf;
+      }
+    });
+    if (lower > upper) {
+      // g_j is identically zero and leaves theta_j free
+      lower = -inf;
+      upper = inf;
+    }
+    range(j, 0) = lower;
+    range(j, 1) = upper;
+  }
+  return range;
+}
+}
+
+Eigen::MatrixXd theta_range_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                                const Eigen::Ref<const Eigen::MatrixXd>& c) {
+  return theta_range_impl(x, c);
+}
+Eigen::MatrixXd theta_range_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                                const SparseRef& c) {
+  return theta_range_impl(x, c);
+}
+Eigen::MatrixXd theta_range_ibd(const SparseRef& x, const SparseRef& c) {
+  return theta_range_impl(x, c);
+}
 
 Eigen::VectorXd lambda2theta_ibd(
     const Eigen::Ref<const Eigen::VectorXd>& lambda,
@@ -38,18 +176,6 @@ Eigen::VectorXd lambda2theta_ibd(
   return theta + gamma * ngradient;
 }
 
-void lambda2theta_void(
-    const Eigen::Ref<const Eigen::VectorXd>& lambda,
-    Eigen::Ref<Eigen::VectorXd> theta,
-    const Eigen::Ref<const Eigen::MatrixXd>& g,
-    const Eigen::Ref<const Eigen::MatrixXd>& c,
-    const double gamma) {
-  Eigen::VectorXd ngradient =
-    (PSEUDO_LOG::dp(Eigen::VectorXd::Ones(g.rows()) + g * lambda).matrix().asDiagonal() * c)
-                                  .array().colwise().sum().transpose() * lambda.array();
-  theta += gamma * ngradient;
-}
-
 Eigen::VectorXd approx_lambda_ibd(
     const Eigen::Ref<const Eigen::MatrixXd>& g0,
     const Eigen::Ref<const Eigen::MatrixXd>& c,
@@ -78,10 +204,12 @@ Eigen::VectorXd approx_lambda_ibd(
   return lambda0 + jacobian * (theta1 - theta0);
 }
 
-std::array<double, 2> pair_confidence_interval_ibd(
+namespace {
+template <typename X, typename C>
+std::array<double, 2> pair_confidence_interval_impl(
     const Eigen::Ref<const Eigen::VectorXd>& theta0,
-    const Eigen::Ref<const Eigen::MatrixXd>& x,
-    const Eigen::Ref<const Eigen::MatrixXd>& c,
+    const X& x,
+    const C& c,
     const Eigen::Ref<const Eigen::MatrixXd>& lhs,
     const double init,
     const double threshold) {
@@ -106,7 +234,7 @@ std::array<double, 2> pair_confidence_interval_ibd(
   }
 
   // lower endpoint
-  double lower_ub;
+  double lower_ub = init;
   double lower_size = upper_ub - init;
   double lower_lb = init - lower_size;
   // lower bound for lower endpoint
@@ -127,6 +255,35 @@ std::array<double, 2> pair_confidence_interval_ibd(
 
   return std::array<double, 2>{lower_ub, upper_lb};
 }
+}
+
+std::array<double, 2> pair_confidence_interval_ibd(
+    const Eigen::Ref<const Eigen::VectorXd>& theta0,
+    const Eigen::Ref<const Eigen::MatrixXd>& x,
+    const Eigen::Ref<const Eigen::MatrixXd>& c,
+    const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+    const double init,
+    const double threshold) {
+  return pair_confidence_interval_impl(theta0, x, c, lhs, init, threshold);
+}
+std::array<double, 2> pair_confidence_interval_ibd(
+    const Eigen::Ref<const Eigen::VectorXd>& theta0,
+    const Eigen::Ref<const Eigen::MatrixXd>& x,
+    const SparseRef& c,
+    const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+    const double init,
+    const double threshold) {
+  return pair_confidence_interval_impl(theta0, x, c, lhs, init, threshold);
+}
+std::array<double, 2> pair_confidence_interval_ibd(
+    const Eigen::Ref<const Eigen::VectorXd>& theta0,
+    const SparseRef& x,
+    const SparseRef& c,
+    const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+    const double init,
+    const double threshold) {
+  return pair_confidence_interval_impl(theta0, x, c, lhs, init, threshold);
+}
 
 Eigen::MatrixXd centering_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
                               const Eigen::Ref<const Eigen::MatrixXd>& c) {
@@ -140,7 +297,7 @@ Eigen::MatrixXd rmvn(const Eigen::MatrixXd& x, const int n) {
   Eigen::MatrixXd I(n, x.cols());
   for (int j = 0; j < x.cols(); ++j) {
     for (int i = 0; i < n; ++i) {
-      I(i, j) = R::rnorm(0, 1.0);
+      I(i, j) = native::norm_rand();
     }
   }
   // get the square root matrix of the covariance matrix
@@ -149,57 +306,753 @@ Eigen::MatrixXd rmvn(const Eigen::MatrixXd& x, const int n) {
   return I * es.operatorSqrt();
 }
 
-double cutoff_pairwise_PB(const Eigen::Ref<const Eigen::MatrixXd>& x,
-                          const Eigen::Ref<const Eigen::MatrixXd>& c,
-                          const std::vector<std::array<int, 2>>& pairs,
-                          const int B,
-                          const double level,
-                          const bool correction) {
-  const Eigen::MatrixXd V_hat = cov_ibd(x, c); // covariance estimate
+namespace {
+// x^e modulo poly over GF(2); polynomials as bit masks
+std::uint64_t gf2_powmod(std::uint64_t e, const std::uint64_t poly,
+                         const int degree) {
+  const auto mulmod = [&](std::uint64_t a, std::uint64_t b) {
+    std::uint64_t product = 0;
+    while (b) {
+      if (b & 1) {
+        product ^= a;
+      }
+      b >>= 1;
+      a <<= 1;
+      if (a >> degree & 1) {
+        a ^= poly;
+      }
+    }
+    return product;
+  };
+  std::uint64_t result = 1;
+  // x, reduced when poly = x + 1
+  std::uint64_t base = degree == 1 ? 1 : 2;
+  while (e) {
+    if (e & 1) {
+      result = mulmod(result, base);
+    }
+    base = mulmod(base, base);
+    e >>= 1;
+  }
+  return result;
+}
+
+// x has order 2^degree - 1 modulo poly
+bool primitive(const std::uint64_t poly, const int degree) {
+  const std::uint64_t order = (std::uint64_t(1) << degree) - 1;
+  if (gf2_powmod(order, poly, degree) != 1) {
+    return false;
+  }
+  std::uint64_t rest = order;
+  for (std::uint64_t q = 2; q * q <= rest; ++q) {
+    if (rest % q == 0) {
+      if (gf2_powmod(order / q, poly, degree) == 1) {
+        return false;
+      }
+      while (rest % q == 0) {
+        rest /= q;
+      }
+    }
+  }
+  return rest == 1 || gf2_powmod(order / rest, poly, degree) != 1;
+}
 
-  // U hat matrices
-  const Eigen::MatrixXd U_hat = rmvn(cov_ibd(x, c), B);
+// Direction numbers(32 bits, most significant first) of a dimension of the
+// Sobol sequence from its primitive polynomial of the given degree and
+// initial values m_1, ..., m_degree
+std::array<std::uint32_t, 32> sobol_column(const std::uint64_t poly,
+                                           const int degree,
+                                           const std::uint64_t* initial) {
+  std::array<std::uint64_t, 32> m;
+  for (int k = 0; k < degree; ++k) {
+    m[k] = initial[k];
+  }
+  for (int k = degree; k < 32; ++k) {
+    m[k] = m[k - degree] ^ (m[k - degree] << degree);
+    for (int i = 1; i < degree; ++i) {
+      if (poly >> (degree - i) & 1) {
+        m[k] ^= m[k - i] << i;
+      }
+    }
+  }
+  std::array<std::uint32_t, 32> v;
+  for (int k = 0; k < 32; ++k) {
+    v[k] = static_cast<std::uint32_t>(m[k] << (31 - k));
+  }
+  return v;
+}
 
-  // B bootstrap statistics(B x m matrix)
-  Eigen::MatrixXd bootstrap_statistics(B, pairs.size());
-  for (int j = 0; j < pairs.size(); ++j) {
-    Eigen::RowVectorXd R = Eigen::RowVectorXd::Zero(1, x.cols());
-    R(pairs[j][0] - 1) = 1;
-    R(pairs[j][1] - 1) = -1;
-    Eigen::MatrixXd A_hat = (R.transpose() * R) / (R * V_hat * R.transpose());
-    bootstrap_statistics.col(j) =
-      (U_hat * A_hat * U_hat.transpose()).diagonal();
+// Direction numbers of the first p dimensions of the Sobol sequence.
+// Dimension 0 is van der Corput and dimensions below SOBOL_DIMENSIONS are
+// those of Joe and Kuo. Further dimensions take the next primitive
+// polynomials in order of degree, with odd initial values m_k below 2^k
+// drawn from a fixed generator so the sequence does not depend on the R
+// seed.
+std::vector<std::array<std::uint32_t, 32>> sobol_directions(const int p) {
+  std::vector<std::array<std::uint32_t, 32>> v(p);
+  for (int k = 0; k < 32; ++k) {
+    v[0][k] = std::uint32_t(1) << (31 - k);
   }
+  std::uint64_t initial[32];
+  int j = 1;
+  for (; j < p && j < SOBOL_DIMENSIONS; ++j) {
+    const std::uint64_t poly = sobol_polynomials[j - 1];
+    int degree = 0;
+    while (poly >> (degree + 1)) {
+      ++degree;
+    }
+    for (int k = 0; k < degree; ++k) {
+      initial[k] = sobol_initial[j - 1][k];
+    }
+    v[j] = sobol_column(poly, degree, initial);
+  }
+  // the table holds every primitive polynomial below its last one
+  std::uint64_t poly = sobol_polynomials[SOBOL_DIMENSIONS - 2];
+  int degree = SOBOL_MAX_DEGREE;
+  std::uint64_t state = 0x9E3779B97F4A7C15ULL;
+  while (j < p && degree < 32) {
+    poly += 2;
+    if (poly >> (degree + 1)) {
+      ++degree;
+      poly = (std::uint64_t(1) << degree) | 1;
+    }
+    if (!primitive(poly, degree)) {
+      continue;
+    }
+    for (int k = 0; k < degree; ++k) {
+      // splitmix64
+      std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      z ^= z >> 31;
+      initial[k] = ((z >> 33) % (std::uint64_t(1) << k)) << 1 | 1;
+    }
+    v[j] = sobol_column(poly, degree, initial);
+    ++j;
+  }
+  return v;
+}
 
-  // cutoff(we only need maximum statistics)
-  Rcpp::Function quantile("quantile");
-  const double cutoff =
-    Rcpp::as<double>(quantile(bootstrap_statistics.rowwise().maxCoeff(),
-                              Rcpp::Named("probs") = 1 - level));
-  if (correction) {
-    const double n = static_cast<double>(x.rows());
-    const double p = static_cast<double>(x.cols());
-    const double a = p * p + p / 2;
-    return cutoff * (1 + a / n);
+std::uint32_t random_bits() {
+  return static_cast<std::uint32_t>(native::unif_rand() * 4294967296.0);
+}
+
+int parity(std::uint32_t x) {
+  x ^= x >> 16;
+  x ^= x >> 8;
+  x ^= x >> 4;
+  x ^= x >> 2;
+  x ^= x >> 1;
+  return x & 1;
+}
+}
+
+Eigen::MatrixXd sobol_normal(const int n, const int p) {
+  std::vector<std::array<std::uint32_t, 32>> v = sobol_directions(p);
+  Eigen::MatrixXd z(n, p);
+  for (int j = 0; j < p; ++j) {
+    // linear scramble: digit d of the output mixes digits 0..d of the input
+    std::array<std::uint32_t, 32> rows;
+    for (int d = 0; d < 32; ++d) {
+      const std::uint32_t digit = std::uint32_t(1) << (31 - d);
+      rows[d] = digit | (random_bits() & ~(2 * digit - 1));
+    }
+    for (int k = 0; k < 32; ++k) {
+      std::uint32_t scrambled = 0;
+      for (int d = 0; d < 32; ++d) {
+        scrambled |= static_cast<std::uint32_t>(parity(rows[d] & v[j][k]))
+          << (31 - d);
+      }
+      v[j][k] = scrambled;
+    }
+    // digital shift, then Gray code order
+    std::uint32_t point = random_bits();
+    for (int i = 0; i < n; ++i) {
+      z(i, j) = native::qnorm((point + 0.5) / 4294967296.0);
+      int k = 0;
+      while (i >> k & 1) {
+        ++k;
+      }
+      point ^= v[j][std::min(k, 31)];
+    }
+  }
+  return z;
+}
+
+Eigen::MatrixXd pivoted_root(const Eigen::Ref<const Eigen::MatrixXd>& V) {
+  // V = P' L D L' P; R = D^1/2 L' P with negative pivots of a singular V
+  // rounded to 0
+  const Eigen::LDLT<Eigen::MatrixXd> ldlt(V);
+  const Eigen::MatrixXd P = ldlt.transpositionsP() *
+    Eigen::MatrixXd::Identity(V.rows(), V.cols());
+  return ldlt.vectorD().cwiseMax(0).cwiseSqrt().asDiagonal() *
+    Eigen::MatrixXd(ldlt.matrixU()) * P;
+}
+
+std::vector<Eigen::MatrixXd> pair_hypotheses(
+    const std::vector<std::array<int, 2>>& pairs,
+    const int p) {
+  std::vector<Eigen::MatrixXd> lhs(pairs.size());
+  for (std::size_t j = 0; j < pairs.size(); ++j) {
+    lhs[j] = Eigen::MatrixXd::Zero(1, p);
+    lhs[j](pairs[j][0] - 1) = 1;
+    lhs[j](pairs[j][1] - 1) = -1;
+  }
+  return lhs;
+}
+
+namespace {
+template <typename X, typename C>
+Eigen::VectorXd pairwise_statistics(const X& x,
+                                    const C& c,
+                                    const Eigen::Ref<const Eigen::VectorXd>& theta0,
+                                    const std::vector<std::array<int, 2>>& pairs,
+                                    const int ncores,
+                                    const int maxit,
+                                    const double abstol,
+                                    std::vector<char>& failed) {
+  const int m = pairs.size();
+  Eigen::VectorXd statistic(m);
+  failed.assign(m, 0);
+  if (batch_execution()) {
+    // one lockstep batch per thread over a contiguous block of pairs
+    const auto& x_dense = as_dense(x);
+    const auto& c_dense = as_dense(c);
+    const std::vector<Eigen::MatrixXd> lhs = pair_hypotheses(pairs, x.cols());
+    const std::vector<Eigen::VectorXd> rhs(m, Eigen::VectorXd::Zero(1));
+    parallel_pairs(1, m, (m + ncores - 1) / ncores, ncores,
+                   [&](const int, const int begin, const int end) {
+      int next = begin;
+      EL_BATCH(x_dense, c_dense, maxit, abstol).run(
+        lhs, rhs, theta0,
+        [&] {return next < end ? next++ : -1;},
+        [] {return -std::numeric_limits<double>::infinity();},
+        [&](const int i, const minEL& result) {
+          failed[i] = !result.convergence;
+          statistic(i) = 2 * result.nlogLR;
+        });
+    });
   } else {
-    return cutoff;
+    // one work unit per pair
+    parallel_pairs(1, m, 1, ncores, [&](const int, const int i, const int) {
+      TRACE_SPAN span("pair", i);
+      Eigen::MatrixXd lhs = Eigen::MatrixXd::Zero(1, x.cols());
+      lhs(pairs[i][0] - 1) = 1;
+      lhs(pairs[i][1] - 1) = -1;
+      minEL pairwise_result =
+        test_ibd_EL(theta0, x, c, lhs, Eigen::Matrix<double, 1, 1>(0),
+                    maxit, abstol);
+      failed[i] = !pairwise_result.convergence;
+      statistic(i) = 2 * pairwise_result.nlogLR;
+    });
   }
-  // return
-  //   Rcpp::as<double>(quantile(bootstrap_statistics.rowwise().maxCoeff(),
-  //                             Rcpp::Named("probs") = 1 - level));
+  return statistic;
 }
 
-double cutoff_pairwise_NB(const Eigen::Ref<const Eigen::MatrixXd>& x,
-                          const Eigen::Ref<const Eigen::MatrixXd>& c,
+template <typename X, typename C>
+PAIRWISE_TESTS pairwise_tests(const X& x,
+                              const C& c,
+                              const std::vector<std::array<int, 2>>& pairs,
+                              const double cutoff,
+                              const bool interval,
+                              const int ncores,
+                              const int maxit,
+                              const double abstol) {
+  const int m = pairs.size();
+  PAIRWISE_TESTS tests;
+  // global minimizer
+  const Eigen::VectorXd theta_hat = col_sums(x).cwiseQuotient(col_sums(c));
+  // statistics(-2logLR)
+  std::vector<char> failed;
+  tests.statistic = pairwise_statistics(x, c, theta_hat, pairs, ncores, maxit,
+                                        abstol, failed);
+  flush_warnings();
+  tests.estimate.resize(m);
+  for (int i = 0; i < m; ++i) {
+    tests.estimate(i) =
+      theta_hat(pairs[i][0] - 1) - theta_hat(pairs[i][1] - 1);
+    if (failed[i]) {
+      native::warning("Test for pair (%i,%i) failed. \n",
+                      pairs[i][0], pairs[i][1]);
+    }
+  }
+  // confidence intervals
+  if (interval) {
+    const std::vector<Eigen::MatrixXd> lhs = pair_hypotheses(pairs, x.cols());
+    tests.CI.resize(m, 2);
+    for (int i = 0; i < m; ++i) {
+      const std::array<double, 2> CI =
+        pair_confidence_interval_ibd(theta_hat, x, c, lhs[i],
+                                     tests.estimate(i), cutoff);
+      tests.CI(i, 0) = CI[0];
+      tests.CI(i, 1) = CI[1];
+    }
+  }
+  return tests;
+}
+}
+
+PAIRWISE_TESTS pairwise_tests_ibd(
+    const Eigen::Ref<const Eigen::MatrixXd>& x,
+    const Eigen::Ref<const Eigen::MatrixXd>& c,
+    const std::vector<std::array<int, 2>>& pairs,
+    const double cutoff,
+    const bool interval,
+    const int ncores,
+    const int maxit,
+    const double abstol) {
+  return pairwise_tests(x, c, pairs, cutoff, interval, ncores, maxit, abstol);
+}
+PAIRWISE_TESTS pairwise_tests_ibd(
+    const Eigen::Ref<const Eigen::MatrixXd>& x,
+    const SparseRef& c,
+    const std::vector<std::array<int, 2>>& pairs,
+    const double cutoff,
+    const bool interval,
+    const int ncores,
+    const int maxit,
+    const double abstol) {
+  return pairwise_tests(x, c, pairs, cutoff, interval, ncores, maxit, abstol);
+}
+PAIRWISE_TESTS pairwise_tests_ibd(
+    const SparseRef& x,
+    const SparseRef& c,
+    const std::vector<std::array<int, 2>>& pairs,
+    const double cutoff,
+    const bool interval,
+    const int ncores,
+    const int maxit,
+    const double abstol) {
+  return pairwise_tests(x, c, pairs, cutoff, interval, ncores, maxit, abstol);
+}
+
+std::uint64_t fingerprint(const std::vector<Eigen::MatrixXd>& lhs,
+                          std::uint64_t seed) {
+  for (const Eigen::MatrixXd& L : lhs) {
+    seed = fingerprint(L.data(), sizeof(double) * L.size(), seed);
+  }
+  return seed;
+}
+
+namespace {
+struct ENTRY {
+  std::int32_t row;
+  std::int32_t col;
+  double value;
+};
+
+std::uint64_t fingerprint_dims(const Eigen::Index rows,
+                               const Eigen::Index cols,
+                               const std::uint64_t seed) {
+  const std::int64_t dims[2] = {rows, cols};
+  return fingerprint(dims, sizeof(dims), seed);
+}
+}
+
+std::uint64_t fingerprint(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                          std::uint64_t seed) {
+  seed = fingerprint_dims(x.rows(), x.cols(), seed);
+  for (int j = 0; j < x.cols(); ++j) {
+    for (int i = 0; i < x.rows(); ++i) {
+      if (x(i, j) != 0) {
+        const ENTRY entry{i, j, x(i, j)};
+        seed = fingerprint(&entry, sizeof(entry), seed);
+      }
+    }
+  }
+  return seed;
+}
+std::uint64_t fingerprint(const SparseRef& x, std::uint64_t seed) {
+  seed = fingerprint_dims(x.rows(), x.cols(), seed);
+  for (int j = 0; j < x.outerSize(); ++j) {
+    for (SparseRef::InnerIterator it(x, j); it; ++it) {
+      if (it.value() != 0) {
+        const ENTRY entry{static_cast<std::int32_t>(it.row()), j, it.value()};
+        seed = fingerprint(&entry, sizeof(entry), seed);
+      }
+    }
+  }
+  return seed;
+}
+
+Eigen::VectorXd bootstrap_PB(const Eigen::Ref<const Eigen::MatrixXd>& V_hat,
+                             const int n,
+                             const std::vector<Eigen::MatrixXd>& lhs,
+                             const int B,
+                             const std::string& checkpoint,
+                             const bool resume,
+                             const bool qmc) {
+  const int p = V_hat.cols();
+
+  // U hat matrices: i.i.d. draws, or blocks of independently scrambled Sobol
+  // points. The pivoted factor puts the largest variances on the leading
+  // Sobol coordinates, which are the most uniform.
+  Eigen::MatrixXd U_hat;
+  if (qmc) {
+    const Eigen::MatrixXd root = pivoted_root(V_hat);
+    U_hat.resize(B, p);
+    for (int r = 0; r < QMC_REPLICATES; ++r) {
+      const int begin = replicate_begin(r, B, QMC_REPLICATES);
+      const int size = replicate_begin(r + 1, B, QMC_REPLICATES) - begin;
+      U_hat.middleRows(begin, size) = sobol_normal(size, p) * root;
+    }
+  } else {
+    U_hat = rmvn(V_hat, B);
+  }
+
+  // A hat matrices: L'(L V L')^-1 L
+  std::vector<Eigen::MatrixXd> A_hat(lhs.size());
+  for (std::size_t j = 0; j < lhs.size(); ++j) {
+    A_hat[j] = lhs[j].transpose() *
+      (lhs[j] * V_hat * lhs[j].transpose()).ldlt().solve(lhs[j]);
+  }
+
+  // checkpoint identified by the covariance estimate, the random draws and
+  // the hypotheses
+  CHECKPOINT ckpt(checkpoint, resume, qmc ? "PB_qmc" : "PB", n, p, B,
+                  fingerprint(lhs, fingerprint(U_hat.data(),
+                                               sizeof(double) * U_hat.size(),
+                                               fingerprint(V_hat))));
+
+  // B bootstrap statistics(we only need maximum statistics), computed in
+  // chunks of replicates so that completed chunks can be checkpointed
+  Eigen::VectorXd bootstrap_statistics(B);
+  const int chunk = 1024;
+  for (int start = 0; start < B; start += chunk) {
+    const int size = std::min(chunk, B - start);
+    bool skip = true;
+    for (int b = start; b < start + size; ++b) {
+      if (ckpt.done(b)) {
+        bootstrap_statistics(b) = ckpt.value(b);
+      } else {
+        skip = false;
+      }
+    }
+    if (skip) {
+      continue;
+    }
+    // chunk statistics(size x m matrix)
+    Eigen::MatrixXd statistics(size, lhs.size());
+    for (std::size_t j = 0; j < lhs.size(); ++j) {
+      statistics.col(j) =
+        (U_hat.middleRows(start, size) * A_hat[j] *
+        U_hat.middleRows(start, size).transpose()).diagonal();
+    }
+    bootstrap_statistics.segment(start, size) = statistics.rowwise().maxCoeff();
+    ckpt.record(start, bootstrap_statistics.data() + start, size);
+  }
+  ckpt.close();
+  return bootstrap_statistics;
+}
+
+double sorted_quantile(const Eigen::Ref<const Eigen::VectorXd>& sorted,
+                       const double prob) {
+  const int B = sorted.size();
+  if (B == 0) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  // as quantile(type = 7) in R
+  const double index = (B - 1) * prob;
+  const int lo = static_cast<int>(std::floor(index));
+  const int hi = static_cast<int>(std::ceil(index));
+  if (index == lo || sorted(hi) == sorted(lo)) {
+    return sorted(lo);
+  }
+  const double h = index - lo;
+  return (1 - h) * sorted(lo) + h * sorted(hi);
+}
+
+double correction_PB(const int p, const int n) {
+  const double a = static_cast<double>(p) * p + p / 2.0;
+  return 1 + a / n;
+}
+
+int replicate_begin(const int r, const int B, const int replicates) {
+  return static_cast<long long>(B) * r / replicates;
+}
+
+Eigen::VectorXd sort_statistics(Eigen::VectorXd statistics,
+                                const int replicates) {
+  if (statistics.hasNaN()) {
+    native::stop("missing values and NaN's not allowed in bootstrap statistics.");
+  }
+  const int B = statistics.size();
+  for (int r = 0; r < replicates; ++r) {
+    std::sort(statistics.data() + replicate_begin(r, B, replicates),
+              statistics.data() + replicate_begin(r + 1, B, replicates));
+  }
+  return statistics;
+}
+
+double replicate_se(const Eigen::Ref<const Eigen::VectorXd>& sorted,
+                    const int replicates,
+                    const double prob) {
+  if (replicates < 2) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  const int B = sorted.size();
+  Eigen::VectorXd quantiles(replicates);
+  for (int r = 0; r < replicates; ++r) {
+    const int begin = replicate_begin(r, B, replicates);
+    quantiles(r) = sorted_quantile(
+      sorted.segment(begin, replicate_begin(r + 1, B, replicates) - begin),
+      prob);
+  }
+  // standard error of the mean of the replicate quantiles
+  const double variance = (quantiles.array() - quantiles.mean()).square().sum() /
+    (replicates - 1);
+  return std::sqrt(variance / replicates);
+}
+
+double cutoff_PB(const Eigen::Ref<const Eigen::MatrixXd>& V_hat,
+                 const int n,
+                 const std::vector<Eigen::MatrixXd>& lhs,
+                 const int B,
+                 const double level,
+                 const bool correction,
+                 const std::string& checkpoint,
+                 const bool resume,
+                 const bool qmc) {
+  // cutoff(we only need maximum statistics)
+  const double cutoff = sorted_quantile(
+    sort_statistics(bootstrap_PB(V_hat, n, lhs, B, checkpoint, resume, qmc)),
+    1 - level);
+  return correction ? cutoff * correction_PB(V_hat.cols(), n) : cutoff;
+}
+
+double cutoff_pairwise_PB(const Eigen::Ref<const Eigen::MatrixXd>& V_hat,
+                          const int n,
+                          const std::vector<std::array<int, 2>>& pairs,
                           const int B,
                           const double level,
-                          const int ncores,
-                          const int maxit,
-                          const double abstol) {
+                          const bool correction,
+                          const std::string& checkpoint,
+                          const bool resume) {
+  return cutoff_PB(V_hat, n, pair_hypotheses(pairs, V_hat.cols()), B, level,
+                   correction, checkpoint, resume);
+}
+
+Eigen::VectorXd euclidean_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                              const Eigen::Ref<const Eigen::MatrixXd>& c,
+                              const std::vector<Eigen::MatrixXd>& lhs) {
+  return euclidean_ibd(DENSE_IBD_MODEL(x, c), lhs);
+}
+Eigen::VectorXd euclidean_ibd(const DENSE_IBD_MODEL& model,
+                              const std::vector<Eigen::MatrixXd>& lhs) {
+  const double n = static_cast<double>(model.data().rows());
+  const Eigen::VectorXd& c_sums = model.incidence_sums();
+  const Eigen::VectorXd& theta_hat = model.estimate();
+  // n * var(theta_hat) = D^-1 S D^-1 with D = diag(c_sums / n) and S the
+  // covariance estimate of g at theta_hat
+  const Eigen::MatrixXd g = model.g(theta_hat);
+  const Eigen::VectorXd d_inv = n * c_sums.cwiseInverse();
+  const Eigen::MatrixXd W =
+    d_inv.asDiagonal() * ((g.transpose() * g) / n) * d_inv.asDiagonal();
+  Eigen::VectorXd statistic(lhs.size());
+  for (std::size_t j = 0; j < lhs.size(); ++j) {
+    // hypotheses at rhs = 0(the bootstrap null)
+    const Eigen::VectorXd difference = lhs[j] * theta_hat;
+    const Eigen::LDLT<Eigen::MatrixXd> ldlt(lhs[j] * W * lhs[j].transpose());
+    // degenerate hypotheses are never screened out
+    statistic(j) = ldlt.isPositive() && (ldlt.vectorD().array() > 0).all() ?
+      n * difference.dot(ldlt.solve(difference)) :
+      std::numeric_limits<double>::infinity();
+    if (std::isnan(statistic(j))) {
+      statistic(j) = std::numeric_limits<double>::infinity();
+    }
+  }
+  return statistic;
+}
+
+double statistic_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                     const Eigen::Ref<const Eigen::MatrixXd>& c,
+                     const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+                     const bool approx_lambda,
+                     const int maxit,
+                     const double abstol,
+                     const double bound) {
+  return statistic_ibd(DENSE_IBD_MODEL(x, c), lhs, approx_lambda, maxit,
+                       abstol, bound);
+}
+double statistic_ibd(const DENSE_IBD_MODEL& model,
+                     const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+                     const bool approx_lambda,
+                     const int maxit,
+                     const double abstol,
+                     const double bound) {
+  const Eigen::VectorXd rhs = Eigen::VectorXd::Zero(lhs.rows());
+  return 2 * (approx_lambda ?
+    test_ibd_EL_approx(model.data(), model.incidence(), lhs, rhs, maxit,
+                       abstol).nlogLR :
+    constrained_EL(model, model.estimate(), lhs, rhs, maxit, abstol,
+                   bound / 2).nlogLR);
+}
+
+namespace {
+// indices in decreasing order of the Euclidean statistics
+std::vector<int> euclidean_order(const Eigen::VectorXd& euclidean) {
+  std::vector<int> order(euclidean.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](const int i, const int j) {
+    return euclidean(i) > euclidean(j);
+  });
+  return order;
+}
+
+// Maximum of the statistics(at rhs = 0) of the hypotheses taken in order
+// while admit(j, maximum) holds, by EL_BATCH. The first is solved alone so
+// that the others are stopped early against it.
+template <typename Admit>
+double batch_max_ibd(const DENSE_IBD_MODEL& model,
+                     const std::vector<Eigen::MatrixXd>& lhs,
+                     const std::vector<int>& order,
+                     const int maxit,
+                     const double abstol,
+                     double maximum,
+                     Admit admit) {
+  std::vector<Eigen::VectorXd> rhs;
+  rhs.reserve(lhs.size());
+  for (const Eigen::MatrixXd& l : lhs) {
+    rhs.push_back(Eigen::VectorXd::Zero(l.rows()));
+  }
+  const Eigen::VectorXd& theta0 = model.estimate();
+  EL_BATCH batch(model.data(), model.incidence(), maxit, abstol);
+  std::size_t next = 0;
+  std::size_t stop = std::min<std::size_t>(1, order.size());
+  const auto queue = [&] {
+    return next < stop && admit(order[next], maximum) ? order[next++] : -1;
+  };
+  const auto bound = [&] {return maximum / 2;};
+  const auto done = [&](const int, const minEL& result) {
+    maximum = std::max(maximum, 2 * result.nlogLR);
+  };
+  batch.run(lhs, rhs, theta0, queue, bound, done);
+  stop = order.size();
+  batch.run(lhs, rhs, theta0, queue, bound, done);
+  return maximum;
+}
+}
+
+double pruned_max_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                      const Eigen::Ref<const Eigen::MatrixXd>& c,
+                      const std::vector<Eigen::MatrixXd>& lhs,
+                      const bool approx_lambda,
+                      const int maxit,
+                      const double abstol,
+                      double maximum) {
+  return pruned_max_ibd(DENSE_IBD_MODEL(x, c), lhs, approx_lambda, maxit,
+                        abstol, maximum);
+}
+double pruned_max_ibd(const DENSE_IBD_MODEL& model,
+                      const std::vector<Eigen::MatrixXd>& lhs,
+                      const bool approx_lambda,
+                      const int maxit,
+                      const double abstol,
+                      double maximum) {
+  // likely maximum first
+  const std::vector<int> order = euclidean_order(euclidean_ibd(model, lhs));
+  if (!approx_lambda && batch_execution()) {
+    return batch_max_ibd(model, lhs, order, maxit, abstol, maximum,
+                         [](const int, const double) {return true;});
+  }
+  for (const int j : order) {
+    TRACE_SPAN span("hypothesis", j);
+    maximum = std::max(maximum,
+                       statistic_ibd(model, lhs[j], approx_lambda,
+                                     maxit, abstol, maximum));
+  }
+  return maximum;
+}
+
+double screened_max_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                        const Eigen::Ref<const Eigen::MatrixXd>& c,
+                        const std::vector<Eigen::MatrixXd>& lhs,
+                        const double margin,
+                        const bool approx_lambda,
+                        const int maxit,
+                        const double abstol,
+                        int& solves) {
+  return screened_max_ibd(DENSE_IBD_MODEL(x, c), lhs, margin, approx_lambda,
+                          maxit, abstol, solves);
+}
+double screened_max_ibd(const DENSE_IBD_MODEL& model,
+                        const std::vector<Eigen::MatrixXd>& lhs,
+                        const double margin,
+                        const bool approx_lambda,
+                        const int maxit,
+                        const double abstol,
+                        int& solves) {
+  const Eigen::VectorXd euclidean = euclidean_ibd(model, lhs);
+  double maximum = -std::numeric_limits<double>::infinity();
+  solves = 0;
+  // exact statistics in decreasing order of the Euclidean statistics
+  const std::vector<int> order = euclidean_order(euclidean);
+  if (!approx_lambda && batch_execution()) {
+    return batch_max_ibd(model, lhs, order, maxit, abstol, maximum,
+                         [&](const int j, const double maximum) {
+      if ((1 + margin) * euclidean(j) < maximum) {
+        return false;
+      }
+      ++solves;
+      return true;
+    });
+  }
+  for (const int j : order) {
+    if ((1 + margin) * euclidean(j) < maximum) {
+      break;
+    }
+    TRACE_SPAN span("hypothesis", j);
+    maximum = std::max(maximum,
+                       statistic_ibd(model, lhs[j], approx_lambda,
+                                     maxit, abstol, maximum));
+    ++solves;
+  }
+  return maximum;
+}
+
+Eigen::VectorXd bootstrap_NB(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                             const Eigen::Ref<const Eigen::MatrixXd>& c,
+                             const std::vector<Eigen::MatrixXd>& lhs,
+                             const int B,
+                             const bool approx_lambda,
+                             const int ncores,
+                             const int maxit,
+                             const double abstol,
+                             const std::string& method,
+                             const std::string& checkpoint,
+                             const bool resume,
+                             const bool screen,
+                             const double margin) {
+  return bootstrap_NB(x, c, lhs, bootstrap_indices(x.rows(), B),
+                      approx_lambda, ncores, maxit, abstol, method,
+                      checkpoint, resume, screen, margin);
+}
+
+Eigen::ArrayXXi bootstrap_indices(const int n, const int B) {
+  // index vector for boostrap(length n * B)
+  // generate index to sample -> reshape to ArrayXXi(Eigen)
+  return Eigen::Map<Eigen::ArrayXXi, Eigen::Unaligned>(
+      native::sample_index(n, n * B).data(), n, B);
+}
+
+Eigen::VectorXd bootstrap_NB(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                             const Eigen::Ref<const Eigen::MatrixXd>& c,
+                             const std::vector<Eigen::MatrixXd>& lhs,
+                             const Eigen::ArrayXXi& bootstrap_index,
+                             const bool approx_lambda,
+                             const int ncores,
+                             const int maxit,
+                             const double abstol,
+                             const std::string& method,
+                             const std::string& checkpoint,
+                             const bool resume,
+                             const bool screen,
+                             const double margin,
+                             BOOTSTRAP_PROGRESS* progress) {
   const int n = x.rows();
   const int p = x.cols();
-  const std::vector<std::array<int, 2>> pairs = all_pairs(p);   // vector of pairs
-  const int m = pairs.size();   // number of hypotheses
+  const int m = lhs.size();   // number of hypotheses
+  const int B = bootstrap_index.cols();
 
   // centered matrix
   // Eigen::MatrixXd&& x_centered = centering_ibd(x, c);
@@ -207,39 +1060,119 @@ double cutoff_pairwise_NB(const Eigen::Ref<const Eigen::MatrixXd>& x,
     x - (c.array().rowwise() *
     (x.array().colwise().sum() / c.array().colwise().sum())).matrix();
 
-  // index vector for boostrap(length n * B)
-  // generate index to sample(Rcpp) -> transform to std::vector ->
-  // reshape to ArrayXXi(Eigen)
-  const Eigen::ArrayXXi bootstrap_index =
-    Eigen::Map<Eigen::ArrayXXi, Eigen::Unaligned>(
-        (Rcpp::as<std::vector<int>>(
-            Rcpp::sample(Rcpp::IntegerVector(Rcpp::seq(0, n - 1)), n * B, true)))
-    .data(), n, B);
+  // checkpoint identified by the data, the bootstrap indices, the hypotheses
+  // and the screening margin(which changes the statistics; -1 without
+  // screening)
+  const double screening = screen ? margin : -1;
+  std::uint64_t key = fingerprint(c, fingerprint(x));
+  key = fingerprint(&screening, sizeof(screening), key);
+  key = fingerprint(bootstrap_index.data(),
+                    sizeof(int) * bootstrap_index.size(), key);
+  CHECKPOINT ckpt(checkpoint, resume, method, n, p, B, fingerprint(lhs, key));
 
   // B bootstrap results(we only need maximum statistics)
   Eigen::VectorXd bootstrap_statistics(B);
-  #pragma omp parallel for num_threads(ncores) default(none) shared(B, maxit, abstol, pairs, x_centered, c, p, m, bootstrap_index, bootstrap_statistics) schedule(auto)
   for (int b = 0; b < B; ++b) {
-    Eigen::ArrayXd statistics_b(m);
-    for (int j = 0; j < m; ++j) {
-      Eigen::MatrixXd lhs = Eigen::MatrixXd::Zero(1, p);
-      lhs(pairs[j][0] - 1) = 1;
-      lhs(pairs[j][1] - 1) = -1;
-      statistics_b(j) =
-        2 * test_ibd_EL(bootstrap_sample(x_centered, bootstrap_index.col(b)),
-                        bootstrap_sample(c, bootstrap_index.col(b)),
-                        lhs, Eigen::Matrix<double, 1, 1>(0),
-                        maxit, abstol).nlogLR;
+    // replicates completed in a previous run
+    if (ckpt.done(b)) {
+      bootstrap_statistics(b) = ckpt.value(b);
+      if (progress) {
+        ++progress->completed;
+        ++progress->resumed;
+      }
     }
-    // need to generalize later for k-FWER control
-    bootstrap_statistics(b) = statistics_b.maxCoeff();
   }
+  // work units of (replicate, block of hypotheses); screening needs all the
+  // hypotheses of a replicate at once
+  const int block_size = screen ? m : pair_block_size(B, m, ncores);
+  REPLICATE_MAX replicate_max(B, (m + block_size - 1) / block_size);
+  // Each thread keeps its latest resample and the model set up on it(the
+  // estimate, hull box and step size shared by all hypotheses). Blocks of a
+  // replicate mostly run back to back, so a replicate is resampled and set
+  // up about once rather than once per block of hypotheses.
+  struct RESAMPLE {
+    int b = -1;
+    Eigen::MatrixXd x;
+    Eigen::MatrixXd c;
+    std::unique_ptr<DENSE_IBD_MODEL> model;
+  };
+  std::vector<RESAMPLE> resamples(std::max(ncores, 1));
+  parallel_pairs(B, m, block_size, ncores,
+                 [&](const int b, const int begin, const int end) {
+    // units still queued when a job is cancelled are skipped
+    if (ckpt.done(b) || (progress && progress->cancelled)) {
+      return;
+    }
+    TRACE_SPAN span("replicate", b);
+    RESAMPLE& resample = resamples[thread_number()];
+    if (resample.b != b) {
+      resample.model.reset();
+      resample.x = bootstrap_sample(x_centered, bootstrap_index.col(b));
+      resample.c = bootstrap_sample(c, bootstrap_index.col(b));
+      resample.model.reset(new DENSE_IBD_MODEL(resample.x, resample.c));
+      resample.b = b;
+    }
+    double statistic = -std::numeric_limits<double>::infinity();
+    if (screen) {
+      int solves;
+      statistic = screened_max_ibd(*resample.model, lhs, margin,
+                                   approx_lambda, maxit, abstol, solves);
+    } else {
+      // hypotheses that cannot exceed the maximum so far are stopped early
+      statistic = pruned_max_ibd(
+        *resample.model,
+        std::vector<Eigen::MatrixXd>(lhs.begin() + begin, lhs.begin() + end),
+        approx_lambda, maxit, abstol, replicate_max.current(b));
+    }
+    // need to generalize later for k-FWER control
+    if (replicate_max.update(b, statistic)) {
+      bootstrap_statistics(b) = replicate_max[b];
+      ckpt.record(b, bootstrap_statistics(b));
+      if (progress) {
+        ++progress->completed;
+      }
+    }
+  });
+  ckpt.close();
+  flush_warnings();
+  return bootstrap_statistics;
+}
 
-  // quantile function needed!
-  Rcpp::Function quantile("quantile");
-  return
-    Rcpp::as<double>(quantile(bootstrap_statistics,
-                              Rcpp::Named("probs") = 1 - level));
+double cutoff_NB(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                 const Eigen::Ref<const Eigen::MatrixXd>& c,
+                 const std::vector<Eigen::MatrixXd>& lhs,
+                 const int B,
+                 const double level,
+                 const bool approx_lambda,
+                 const int ncores,
+                 const int maxit,
+                 const double abstol,
+                 const std::string& method,
+                 const std::string& checkpoint,
+                 const bool resume,
+                 const bool screen,
+                 const double margin) {
+  return sorted_quantile(
+    sort_statistics(bootstrap_NB(x, c, lhs, B, approx_lambda, ncores, maxit,
+                                 abstol, method, checkpoint, resume, screen,
+                                 margin)),
+    1 - level);
+}
+
+double cutoff_pairwise_NB(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                          const Eigen::Ref<const Eigen::MatrixXd>& c,
+                          const int B,
+                          const double level,
+                          const int ncores,
+                          const int maxit,
+                          const double abstol,
+                          const std::string& checkpoint,
+                          const bool resume,
+                          const bool screen,
+                          const double margin) {
+  return cutoff_NB(x, c, pair_hypotheses(all_pairs(x.cols()), x.cols()), B,
+                   level, false, ncores, maxit, abstol, "NB", checkpoint,
+                   resume, screen, margin);
 }
 
 double cutoff_pairwise_NB_approx(const Eigen::Ref<const Eigen::MatrixXd>& x,
@@ -248,54 +1181,113 @@ double cutoff_pairwise_NB_approx(const Eigen::Ref<const Eigen::MatrixXd>& x,
                                  const double level,
                                  const int ncores,
                                  const int maxit,
-                                 const double abstol) {
-  const int n = x.rows();
-  const int p = x.cols();
-  const std::vector<std::array<int, 2>> pairs = all_pairs(p);   // vector of pairs
-  const int m = pairs.size();   // number of hypotheses
+                                 const double abstol,
+                                 const std::string& checkpoint,
+                                 const bool resume,
+                                 const bool screen,
+                                 const double margin) {
+  return cutoff_NB(x, c, pair_hypotheses(all_pairs(x.cols()), x.cols()), B,
+                   level, true, ncores, maxit, abstol, "NB_apx", checkpoint,
+                   resume, screen, margin);
+}
 
-  // centered matrix
-  // Eigen::MatrixXd&& x_centered = centering_ibd(x, c);
-  const Eigen::MatrixXd x_centered =
-    x - (c.array().rowwise() *
-    (x.array().colwise().sum() / c.array().colwise().sum())).matrix();
+namespace {
+template <typename X, typename C>
+PAIRWISE_CUTOFF pairwise_cutoff_impl(
+    const X& x,
+    const C& c,
+    const std::vector<std::array<int, 2>>& pairs,
+    const PAIRWISE_BOOTSTRAP& o,
+    Eigen::VectorXd distribution,
+    const int replicates) {
+  PAIRWISE_CUTOFF result;
+  result.replicates = replicates;
+  if (distribution.size() == 0) {
+    const std::vector<Eigen::MatrixXd> lhs = pair_hypotheses(pairs, x.cols());
+    if (o.method == "PB") {
+      distribution = bootstrap_PB(cov_ibd(x, c), x.rows(), lhs, o.B,
+                                  o.checkpoint, o.resume, o.qmc);
+      result.replicates = o.qmc ? QMC_REPLICATES : 1;
+    } else {
+      // resampled blocks are dense
+      distribution = bootstrap_NB(as_dense(x), as_dense(c), lhs, o.B,
+                                  o.approx_lambda, o.ncores, o.maxit,
+                                  o.abstol, o.approx_lambda ? "NB_apx" : "NB",
+                                  o.checkpoint, o.resume, o.screen, o.margin);
+      result.replicates = 1;
+    }
+    distribution = sort_statistics(std::move(distribution), result.replicates);
+  }
+  // cutoff value from the pooled replicates
+  result.cutoff = sorted_quantile(
+    result.replicates > 1 ? sort_statistics(distribution) : distribution,
+    1 - o.level);
+  result.se = replicate_se(distribution, result.replicates, 1 - o.level);
+  if (o.method == "PB" && o.correction) {
+    result.cutoff *= correction_PB(x.cols(), x.rows());
+    result.se *= correction_PB(x.cols(), x.rows());
+  }
+  result.distribution = std::move(distribution);
+  return result;
+}
+}
 
-  // index vector for boostrap(length n * B)
-  // generate index to sample(Rcpp) -> transform to std::vector ->
-  // reshape to ArrayXXi(Eigen)
-  const Eigen::ArrayXXi bootstrap_index =
-    Eigen::Map<Eigen::ArrayXXi, Eigen::Unaligned>(
-        (Rcpp::as<std::vector<int>>(
-            Rcpp::sample(Rcpp::IntegerVector(Rcpp::seq(0, n - 1)), n * B, true)))
-    .data(), n, B);
+PAIRWISE_CUTOFF pairwise_cutoff(
+    const Eigen::Ref<const Eigen::MatrixXd>& x,
+    const Eigen::Ref<const Eigen::MatrixXd>& c,
+    const std::vector<std::array<int, 2>>& pairs,
+    const PAIRWISE_BOOTSTRAP& options,
+    Eigen::VectorXd distribution,
+    const int replicates) {
+  return pairwise_cutoff_impl(x, c, pairs, options, std::move(distribution),
+                              replicates);
+}
+PAIRWISE_CUTOFF pairwise_cutoff(
+    const Eigen::Ref<const Eigen::MatrixXd>& x,
+    const SparseRef& c,
+    const std::vector<std::array<int, 2>>& pairs,
+    const PAIRWISE_BOOTSTRAP& options,
+    Eigen::VectorXd distribution,
+    const int replicates) {
+  return pairwise_cutoff_impl(x, c, pairs, options, std::move(distribution),
+                              replicates);
+}
+PAIRWISE_CUTOFF pairwise_cutoff(
+    const SparseRef& x,
+    const SparseRef& c,
+    const std::vector<std::array<int, 2>>& pairs,
+    const PAIRWISE_BOOTSTRAP& options,
+    Eigen::VectorXd distribution,
+    const int replicates) {
+  return pairwise_cutoff_impl(x, c, pairs, options, std::move(distribution),
+                              replicates);
+}
 
-  // B bootstrap results(we only need maximum statistics)
-  Eigen::VectorXd bootstrap_statistics(B);
-  #pragma omp parallel for num_threads(ncores) default(none) shared(B, maxit, abstol, pairs, x_centered, c, p, m, bootstrap_index, bootstrap_statistics) schedule(auto)
-  for (int b = 0; b < B; ++b) {
-    Eigen::ArrayXd statistics_b(m);
-    for (int j = 0; j < m; ++j) {
-      Eigen::MatrixXd lhs = Eigen::MatrixXd::Zero(1, p);
-      lhs(pairs[j][0] - 1) = 1;
-      lhs(pairs[j][1] - 1) = -1;
-      statistics_b(j) =
-        2 * test_ibd_EL_approx(
-            bootstrap_sample(x_centered, bootstrap_index.col(b)),
-            bootstrap_sample(c, bootstrap_index.col(b)),
-            lhs, Eigen::Matrix<double, 1, 1>(0),
-            maxit, abstol).nlogLR;
-      }
-    // need to generalize later for k-FWER control
-    bootstrap_statistics(b) = statistics_b.maxCoeff();
-    }
 
-  // quantile function needed!
-  Rcpp::Function quantile("quantile");
-  return
-    Rcpp::as<double>(quantile(bootstrap_statistics,
-                              Rcpp::Named("probs") = 1 - level));
+Eigen::MatrixXd weighted_crossprod(const Eigen::Ref<const Eigen::MatrixXd>& c,
+                                   const Eigen::VectorXd& w) {
+  return c.transpose() * w.asDiagonal() * c;
+}
+Eigen::MatrixXd weighted_crossprod(const SparseRef& c,
+                                   const Eigen::VectorXd& w) {
+  const Eigen::SparseMatrix<double> wc = w.asDiagonal() * c;
+  return Eigen::MatrixXd(Eigen::SparseMatrix<double>(c.transpose() * wc));
 }
 
+namespace {
+template <typename X, typename C>
+minEL test_ibd_EL_impl(const Eigen::Ref<const Eigen::VectorXd>& theta0,
+                       const X& x,
+                       const C& c,
+                       const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+                       const Eigen::Ref<const Eigen::VectorXd>& rhs,
+                       const int maxit,
+                       const double abstol,
+                       const double bound) {
+  return constrained_EL(IBD_MODEL<X, C>(x, c), theta0, lhs, rhs, maxit,
+                        abstol, bound);
+}
+}
 
 minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
                   const Eigen::Ref<const Eigen::MatrixXd>& x,
@@ -304,78 +1296,28 @@ minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
                   const Eigen::Ref<const Eigen::VectorXd>& rhs,
                   const int maxit,
                   const double abstol) {
-  /// initialization ///
-  // Constraint imposed on the initial value by projection.
-  // The initial value is given as treatment means.
-  Eigen::VectorXd theta =
-    linear_projection(theta0, lhs, rhs);
-  // estimating function
-  Eigen::MatrixXd g = g_ibd(theta, x, c);
-  // evaluation
-  Eigen::VectorXd lambda = EL2(g).lambda;
-  // for current function value(-logLR)
-  double f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g.rows()) + g * lambda);
-
-  /// minimization(projected gradient descent) ///
-  double gamma = 1.0 / (c.array().colwise().sum().mean());    // step size
-  bool convergence = false;
-  int iterations = 0;
-  // proposed value for theta
-  while (!convergence && iterations != maxit) {
-    // update parameter by GD with lambda fixed -> projection
-    Eigen::VectorXd theta_tmp = theta;
-    lambda2theta_void(lambda, theta_tmp, g, c, gamma);
-    linear_projection_void(theta_tmp, lhs, rhs);
-    // update g
-    Eigen::MatrixXd g_tmp = g_ibd(theta_tmp, x, c);
-    // update lambda
-    EL2 eval(g_tmp);
-    Eigen::VectorXd lambda_tmp = eval.lambda;
-    if (!eval.convergence && iterations > 9) {
-      lambda = std::move(lambda_tmp);
-      Rcpp::warning("Convex hull constraint not satisfied during optimization. Optimization halted.");
-      break;
-    }
-
-    // update function value
-    double f0 = f1;
-    f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g_tmp.rows()) + g_tmp * lambda_tmp);
-
-    // step halving to ensure that the updated function value be
-    // strictly less than the current function value
-    while (f0 < f1) {
-      // reduce step size
-      gamma /= 2;
-      // propose new theta
-      theta_tmp = theta;
-      lambda2theta_void(lambda, theta_tmp, g, c, gamma);
-      linear_projection_void(theta_tmp, lhs, rhs);
-      // propose new lambda
-      g_tmp = g_ibd(theta_tmp, x, c);
-      lambda_tmp = EL2(g_tmp).lambda;
-      if (gamma < abstol) {
-        lambda = std::move(lambda_tmp);
-        Rcpp::warning("Convex hull constraint not satisfied during step halving.");
-        break;
-      }
-      // propose new function value
-      f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g_tmp.rows()) + g_tmp * lambda_tmp);
-    }
-
-    // update parameters
-    theta = std::move(theta_tmp);
-    lambda = std::move(lambda_tmp);
-    g = std::move(g_tmp);
-
-    // convergence check
-    if (f0 - f1 < abstol && iterations > 0) {
-      convergence = true;
-    } else {
-      ++iterations;
-    }
-  }
-
-  return {theta, lambda, f1, iterations, convergence};
+  return test_ibd_EL_impl(theta0, x, c, lhs, rhs, maxit, abstol,
+                          -std::numeric_limits<double>::infinity());
+}
+minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
+                  const Eigen::Ref<const Eigen::MatrixXd>& x,
+                  const SparseRef& c,
+                  const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+                  const Eigen::Ref<const Eigen::VectorXd>& rhs,
+                  const int maxit,
+                  const double abstol) {
+  return test_ibd_EL_impl(theta0, x, c, lhs, rhs, maxit, abstol,
+                          -std::numeric_limits<double>::infinity());
+}
+minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
+                  const SparseRef& x,
+                  const SparseRef& c,
+                  const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+                  const Eigen::Ref<const Eigen::VectorXd>& rhs,
+                  const int maxit,
+                  const double abstol) {
+  return test_ibd_EL_impl(theta0, x, c, lhs, rhs, maxit, abstol,
+                          -std::numeric_limits<double>::infinity());
 }
 
 minEL test_ibd_EL(const Eigen::Ref<const Eigen::MatrixXd>& x,
@@ -383,78 +1325,12 @@ minEL test_ibd_EL(const Eigen::Ref<const Eigen::MatrixXd>& x,
                   const Eigen::Ref<const Eigen::MatrixXd>& lhs,
                   const Eigen::Ref<const Eigen::VectorXd>& rhs,
                   const int maxit,
-                  const double abstol) {
-  /// initialization ///
-  // Constraint imposed on the initial value by projection.
+                  const double abstol,
+                  const double bound) {
   // The initial value is given as treatment means.
-  Eigen::VectorXd theta =
-    linear_projection(x.array().colwise().sum() / c.array().colwise().sum(),
-                      lhs, rhs);
-  // estimating function
-  Eigen::MatrixXd g = g_ibd(theta, x, c);
-  // evaluation
-  Eigen::VectorXd lambda = EL2(g).lambda;
-  // for current function value(-logLR)
-  double f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g.rows()) + g * lambda);
-
-  /// minimization(projected gradient descent) ///
-  double gamma = 1.0 / (c.array().colwise().sum().mean());    // step size
-  bool convergence = false;
-  int iterations = 0;
-  // proposed value for theta
-  while (!convergence && iterations != maxit) {
-    // update parameter by GD with lambda fixed -> projection
-    Eigen::VectorXd theta_tmp = theta;
-    lambda2theta_void(lambda, theta_tmp, g, c, gamma);
-    linear_projection_void(theta_tmp, lhs, rhs);
-    // update g
-    Eigen::MatrixXd g_tmp = g_ibd(theta_tmp, x, c);
-    // update lambda
-    EL2 eval(g_tmp);
-    Eigen::VectorXd lambda_tmp = eval.lambda;
-    if (!eval.convergence && iterations > 9) {
-      lambda = std::move(lambda_tmp);
-      Rcpp::warning("Convex hull constraint not satisfied during optimization. Optimization halted.");
-      break;
-    }
-    // update function value
-    double f0 = f1;
-    f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g_tmp.rows()) + g_tmp * lambda_tmp);
-    // step halving to ensure that the updated function value be
-    // strictly less than the current function value
-    while (f0 < f1) {
-      // reduce step size
-      gamma /= 2;
-      // propose new theta
-      theta_tmp = theta;
-      lambda2theta_void(lambda, theta_tmp, g, c, gamma);
-      linear_projection_void(theta_tmp, lhs, rhs);
-      // propose new lambda
-      g_tmp = g_ibd(theta_tmp, x, c);
-      lambda_tmp = EL2(g_tmp).lambda;
-      if (gamma < abstol) {
-        lambda = std::move(lambda_tmp);
-        Rcpp::warning("Convex hull constraint not satisfied during step halving.");
-        break;
-      }
-      // propose new function value
-      f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g_tmp.rows()) + g_tmp * lambda_tmp);
-    }
-
-    // update parameters
-    theta = std::move(theta_tmp);
-    lambda = std::move(lambda_tmp);
-    g = std::move(g_tmp);
-
-    // convergence check
-    if (f0 - f1 < abstol && iterations > 0) {
-      convergence = true;
-    } else {
-      ++iterations;
-    }
-  }
-
-  return {theta, lambda, f1, iterations, convergence};
+  const DENSE_IBD_MODEL model(x, c);
+  return constrained_EL(model, model.estimate(), lhs, rhs, maxit, abstol,
+                        bound);
 }
 
 minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
@@ -470,6 +1346,11 @@ minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
   // The initial value is given as treatment means.
   Eigen::VectorXd theta =
     linear_projection(theta0, lhs, rhs);
+  // no theta satisfying the constraint has 0 inside the convex hull
+  if (range_separated(theta_range_ibd(x, c), lhs, rhs)) {
+    return {theta, Eigen::VectorXd::Zero(theta.size()),
+            std::numeric_limits<double>::infinity(), 0, false, 0};
+  }
 
   // estimating function
   Eigen::MatrixXd g = g_ibd(theta, x, c);
@@ -477,14 +1358,35 @@ minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
   EL eval = getEL(g);
   Eigen::VectorXd lambda = eval.lambda;
   // for current function value(-logLR)
-  double f0 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g.rows()) + g * lambda);
+  double scale;
+  double f0 =
+    PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g.rows()) + g * lambda, scale);
   // for updated function value
   double f1 = f0;
 
   /// minimization(projected gradient descent) ///
-  double gamma = 1.0 / (c.array().colwise().sum().mean());    // step size
+  double gamma = 1.0 / col_sums(c).mean();    // step size
   bool convergence = false;
   int iterations = 0;
+  // With approx_lambda, after the first two iterations lambda at a proposal
+  // is linearized around the current point; otherwise it is solved exactly.
+  // The linearization drifts from the solution as theta
+  // moves, so it is refined by Newton iterations started from it when its
+  // Newton decrement, the shortfall of -logLR at the approximation, exceeds
+  // the tolerance of -logLR.
+  int refreshes = 0;
+  const auto approximate = [&](const Eigen::MatrixXd& g_tmp,
+                               const Eigen::VectorXd& theta_tmp) {
+    Eigen::VectorXd lambda_tmp =
+      approx_lambda_ibd(g, c, theta, theta_tmp, lambda);
+    if (!(lambda_decrement(g_tmp, lambda_tmp) <=
+          PSEUDO_LOG::tolerance(abstol, scale))) {
+      TRACE_SPAN span("lambda refresh", iterations);
+      ++refreshes;
+      lambda_tmp = refine_EL(g_tmp, lambda_tmp).lambda;
+    }
+    return lambda_tmp;
+  };
   // proposed value for theta
   // Eigen::VectorXd theta_tmp(theta.size());
   // Eigen::VectorXd lambda_tmp(theta.size());
@@ -560,9 +1462,9 @@ minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
     Eigen::MatrixXd g_tmp = g_ibd(theta_tmp, x, c);
 
     Eigen::VectorXd lambda_tmp(theta.size());
-    if (iterations > 1) {
+    if (approx_lambda && iterations > 1) {
       // update lambda
-      lambda_tmp = approx_lambda_ibd(g, c, theta, theta_tmp, lambda);
+      lambda_tmp = approximate(g_tmp, theta_tmp);
     } else {
       // update lambda
       eval = getEL(g_tmp);
@@ -571,18 +1473,20 @@ minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
       if (!eval.convergence && iterations > 9) {
         theta = std::move(theta_tmp);
         lambda = std::move(lambda_tmp);
-        Rcpp::warning("Convex hull constraint not satisfied during optimization. Optimization halted.");
+        el_warning("Convex hull constraint not satisfied during optimization. Optimization halted.");
         break;
       }
     }
 
     // update function value
     f0 = f1;
-    f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g_tmp.rows()) + g_tmp * lambda_tmp);
+    f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g_tmp.rows()) + g_tmp * lambda_tmp,
+                         scale);
 
     // step halving to ensure that the updated function value be
-    // strictly less than the current function value
-    while (f0 < f1) {
+    // strictly less than the current function value, up to rounding
+    while (f1 - f0 > PSEUDO_LOG::resolution(scale)) {
+      TRACE_SPAN span("step halving", iterations);
       // reduce step size
       gamma /= 2;
       // propose new theta
@@ -591,8 +1495,8 @@ minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
                           lhs, rhs);
       // propose new lambda
       g_tmp = g_ibd(theta_tmp, x, c);
-      if (iterations > 1) {
-        lambda_tmp = approx_lambda_ibd(g, c, theta, theta_tmp, lambda);
+      if (approx_lambda && iterations > 1) {
+        lambda_tmp = approximate(g_tmp, theta_tmp);
       } else {
         eval = getEL(g_tmp);
         lambda_tmp = eval.lambda;
@@ -600,11 +1504,12 @@ minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
       if (gamma < abstol) {
         theta = std::move(theta_tmp);
         lambda = std::move(lambda_tmp);
-        Rcpp::warning("Convex hull constraint not satisfied during step halving.");
+        el_warning("Convex hull constraint not satisfied during step halving.");
         break;
       }
       // propose new function value
-      f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g_tmp.rows()) + g_tmp * lambda_tmp);
+      f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g_tmp.rows()) + g_tmp * lambda_tmp,
+                           scale);
     }
 
     // update parameters
@@ -613,14 +1518,14 @@ minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
     g = std::move(g_tmp);
 
     // convergence check
-    if (f0 - f1 < abstol && iterations > 0) {
+    if (f0 - f1 < PSEUDO_LOG::tolerance(abstol, scale) && iterations > 0) {
       convergence = true;
     } else {
       ++iterations;
     }
   }
 
-  return {theta, lambda, f1, iterations, convergence};
+  return {theta, lambda, f1, iterations, convergence, refreshes};
 }
 
 minEL test_ibd_EL_approx(const Eigen::Ref<const Eigen::MatrixXd>& x,
@@ -629,94 +1534,7 @@ minEL test_ibd_EL_approx(const Eigen::Ref<const Eigen::MatrixXd>& x,
                          const Eigen::Ref<const Eigen::VectorXd>& rhs,
                          const int maxit,
                          const double abstol) {
-  /// initialization ///
-  // Constraint imposed on the initial value by projection.
   // The initial value is given as treatment means.
-  Eigen::VectorXd theta =
-    linear_projection(x.array().colwise().sum() / c.array().colwise().sum(),
-                      lhs, rhs);
-
-  // estimating function
-  Eigen::MatrixXd g = g_ibd(theta, x, c);
-  // evaluation
-  EL eval = getEL(g);
-  Eigen::VectorXd lambda = eval.lambda;
-  // for current function value(-logLR)
-  double f0 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g.rows()) + g * lambda);
-  // for updated function value
-  double f1 = f0;
-
-  /// minimization(projected gradient descent) ///
-  double gamma = 1.0 / (c.array().colwise().sum().mean());    // step size
-  bool convergence = false;
-  int iterations = 0;
-
-  while (!convergence && iterations != maxit) {
-    // update parameter by GD with lambda fixed -> projection
-    Eigen::VectorXd theta_tmp =
-      linear_projection(lambda2theta_ibd(lambda, theta, g, c, gamma), lhs, rhs);
-    // update g
-    Eigen::MatrixXd g_tmp = g_ibd(theta_tmp, x, c);
-
-    Eigen::VectorXd lambda_tmp(theta.size());
-      if (iterations > 1) {
-      // update lambda
-      lambda_tmp = approx_lambda_ibd(g, c, theta, theta_tmp, lambda);
-    } else {
-      // update lambda
-      eval = getEL(g_tmp);
-      lambda_tmp = eval.lambda;
-      if (!eval.convergence && iterations > 9) {
-        theta = std::move(theta_tmp);
-        lambda = std::move(lambda_tmp);
-        Rcpp::warning("Convex hull constraint not satisfied during optimization. Optimization halted.");
-        break;
-      }
-    }
-
-    // update function value
-    f0 = f1;
-    f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g_tmp.rows()) + g_tmp * lambda_tmp);
-
-    // step halving to ensure that the updated function value be
-    // strictly less than the current function value
-    while (f0 < f1) {
-      // reduce step size
-      gamma /= 2;
-      // propose new theta
-      theta_tmp =
-        linear_projection(lambda2theta_ibd(lambda, theta, g, c, gamma),
-                          lhs, rhs);
-      // propose new lambda
-      g_tmp = g_ibd(theta_tmp, x, c);
-      if (iterations > 1) {
-        lambda_tmp = approx_lambda_ibd(g, c, theta, theta_tmp, lambda);
-      } else {
-        eval = getEL(g_tmp);
-        lambda_tmp = eval.lambda;
-      }
-      if (gamma < abstol) {
-        theta = std::move(theta_tmp);
-        lambda = std::move(lambda_tmp);
-        Rcpp::warning("Convex hull constraint not satisfied during step halving.");
-        break;
-      }
-      // propose new function value
-      f1 = PSEUDO_LOG::sum(Eigen::VectorXd::Ones(g_tmp.rows()) + g_tmp * lambda_tmp);
-    }
-
-    // update parameters
-    theta = std::move(theta_tmp);
-    lambda = std::move(lambda_tmp);
-    g = std::move(g_tmp);
-
-    // convergence check
-    if (f0 - f1 < abstol && iterations > 0) {
-      convergence = true;
-    } else {
-      ++iterations;
-    }
-  }
-
-  return {theta, lambda, f1, iterations, convergence};
+  return test_ibd_EL(col_sums(x).cwiseQuotient(col_sums(c)), x, c,
+                     lhs, rhs, true, maxit, abstol);
 }
@@ -3,14 +3,109 @@
 
 #include "EL.h"
 #include "utils.h"
-#include <omp.h>
+#include "checkpoint.h"
+#include <atomic>
+#include <limits>
+#include <numeric>
 
 Eigen::MatrixXd g_ibd(const Eigen::Ref<const Eigen::VectorXd>& theta,
                       const Eigen::Ref<const Eigen::MatrixXd>& x,
                       const Eigen::Ref<const Eigen::MatrixXd>& c);
+Eigen::MatrixXd g_ibd(const Eigen::Ref<const Eigen::VectorXd>& theta,
+                      const Eigen::Ref<const Eigen::MatrixXd>& x,
+                      const SparseRef& c);
+Eigen::MatrixXd g_ibd(const Eigen::Ref<const Eigen::VectorXd>& theta,
+                      const SparseRef& x,
+                      const SparseRef& c);
 
 Eigen::MatrixXd cov_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
                         const Eigen::Ref<const Eigen::MatrixXd>& c);
+Eigen::MatrixXd cov_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                        const SparseRef& c);
+Eigen::MatrixXd cov_ibd(const SparseRef& x, const SparseRef& c);
+
+// Intervals(lower, upper) of theta_j for which the j-th column of g_ibd
+// takes both signs(or vanishes when lower == upper); c must be nonnegative.
+// Outside of them 0 is not in the convex hull of g and -logLR is infinite.
+Eigen::MatrixXd theta_range_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                                const Eigen::Ref<const Eigen::MatrixXd>& c);
+Eigen::MatrixXd theta_range_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                                const SparseRef& c);
+Eigen::MatrixXd theta_range_ibd(const SparseRef& x, const SparseRef& c);
+// c' * diag(w) * c for dense and sparse c
+Eigen::MatrixXd weighted_crossprod(const Eigen::Ref<const Eigen::MatrixXd>& c,
+                                   const Eigen::VectorXd& w);
+Eigen::MatrixXd weighted_crossprod(const SparseRef& c,
+                                   const Eigen::VectorXd& w);
+
+// Block design model for constrained_EL: g(theta) = x - c * diag(theta).
+// x and c are Eigen::Ref views(dense or SparseRef) held by value. The
+// unconstrained estimate, the hull box and the step size are computed once
+// on construction, so one model serves all the hypotheses tested on a data
+// set, e.g. every pair of a bootstrap replicate.
+template <typename X, typename C>
+class IBD_MODEL {
+public:
+  IBD_MODEL(const X& x, const C& c)
+    : x(x), c(c), c_sums(col_sums(c)),
+      theta_hat(col_sums(x).cwiseQuotient(c_sums)),
+      box(theta_range_ibd(x, c)) {}
+
+  const X& data() const {return x;}
+  const C& incidence() const {return c;}
+  const Eigen::VectorXd& incidence_sums() const {return c_sums;}
+  // treatment means
+  const Eigen::VectorXd& estimate() const {return theta_hat;}
+
+  Eigen::MatrixXd g(const Eigen::Ref<const Eigen::VectorXd>& theta) const {
+    return g_ibd(theta, x, c);
+  }
+  Eigen::VectorXd theta_gradient(const Eigen::Ref<const Eigen::VectorXd>&,
+                                 const Eigen::Ref<const Eigen::VectorXd>& lambda,
+                                 const Eigen::Ref<const Eigen::VectorXd>& dplog) const {
+    return -(c.transpose() * dplog).cwiseProduct(lambda);
+  }
+  double step_size() const {return 1.0 / c_sums.mean();}
+  const Eigen::MatrixXd& range() const {return box;}
+  void kkt_blocks(const Eigen::Ref<const Eigen::VectorXd>&,
+                  const Eigen::Ref<const Eigen::VectorXd>& lambda,
+                  const Eigen::Ref<const Eigen::MatrixXd>& g,
+                  const Eigen::Ref<const Eigen::VectorXd>& dplog,
+                  const Eigen::Ref<const Eigen::VectorXd>& neg_d2plog,
+                  Eigen::MatrixXd& H_tl,
+                  Eigen::MatrixXd& H_tt) const {
+    H_tl = lambda.asDiagonal() *
+      Eigen::MatrixXd(c.transpose() * (neg_d2plog.asDiagonal() * g));
+    H_tl.diagonal() -= c.transpose() * dplog;
+    H_tt = -(lambda.asDiagonal() * weighted_crossprod(c, neg_d2plog) *
+      lambda.asDiagonal());
+  }
+  void kkt_row(const int i,
+               const Eigen::Ref<const Eigen::VectorXd>&,
+               const Eigen::Ref<const Eigen::VectorXd>& lambda,
+               const Eigen::Ref<const Eigen::VectorXd>& g_i,
+               const double dplog,
+               const double neg_d2plog,
+               Eigen::VectorXd& gradient,
+               Eigen::MatrixXd& H_tl,
+               Eigen::MatrixXd& H_tt) const {
+    const Eigen::VectorXd c_i = c.row(i).transpose();
+    const Eigen::VectorXd c_lambda = c_i.cwiseProduct(lambda);
+    gradient = -dplog * c_lambda;
+    H_tl = neg_d2plog * c_lambda * g_i.transpose();
+    H_tl.diagonal() -= dplog * c_i;
+    H_tt = -neg_d2plog * c_lambda * c_lambda.transpose();
+  }
+
+private:
+  const X x;
+  const C c;
+  const Eigen::VectorXd c_sums;
+  const Eigen::VectorXd theta_hat;
+  const Eigen::MatrixXd box;
+};
+typedef IBD_MODEL<Eigen::Ref<const Eigen::MatrixXd>,
+                  Eigen::Ref<const Eigen::MatrixXd>> DENSE_IBD_MODEL;
 
 Eigen::VectorXd lambda2theta_ibd(const Eigen::Ref<const Eigen::VectorXd>& lambda,
                                  const Eigen::Ref<const Eigen::VectorXd>& theta,
@@ -18,13 +113,6 @@ Eigen::VectorXd lambda2theta_ibd(const Eigen::Ref<const Eigen::VectorXd>& lambda
                                  const Eigen::Ref<const Eigen::MatrixXd>& c,
                                  const double gamma);
 
-void lambda2theta_void(
-        const Eigen::Ref<const Eigen::VectorXd>& lambda,
-        Eigen::Ref<Eigen::VectorXd> theta,
-        const Eigen::Ref<const Eigen::MatrixXd>& g,
-        const Eigen::Ref<const Eigen::MatrixXd>& c,
-        const double gamma);
-
 Eigen::VectorXd approx_lambda_ibd(
         const Eigen::Ref<const Eigen::MatrixXd>& g0,
         const Eigen::Ref<const Eigen::MatrixXd>& c,
@@ -39,32 +127,329 @@ std::array<double, 2> pair_confidence_interval_ibd(
     const Eigen::Ref<const Eigen::MatrixXd>& lhs,
     const double init,
     const double threshold);
+std::array<double, 2> pair_confidence_interval_ibd(
+    const Eigen::Ref<const Eigen::VectorXd>& theta0,
+    const Eigen::Ref<const Eigen::MatrixXd>& x,
+    const SparseRef& c,
+    const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+    const double init,
+    const double threshold);
+std::array<double, 2> pair_confidence_interval_ibd(
+    const Eigen::Ref<const Eigen::VectorXd>& theta0,
+    const SparseRef& x,
+    const SparseRef& c,
+    const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+    const double init,
+    const double threshold);
 
 Eigen::MatrixXd centering_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
                               const Eigen::Ref<const Eigen::MatrixXd>& c);
 
 Eigen::MatrixXd rmvn(const Eigen::MatrixXd& x, const int n);
+// n x p standard normal points: the first n points of the p-dimensional
+// Sobol sequence under a random linear scramble and digital shift(drawn from
+// R's generator), through the normal quantile function. Balanced for n a
+// power of 2.
+Eigen::MatrixXd sobol_normal(const int n, const int p);
+// R with R' * R = V from the LDLT decomposition with diagonal pivoting, for
+// positive semidefinite V
+Eigen::MatrixXd pivoted_root(const Eigen::Ref<const Eigen::MatrixXd>& V);
 
-double cutoff_pairwise_PB(const Eigen::Ref<const Eigen::MatrixXd>& x,
-                          const Eigen::Ref<const Eigen::MatrixXd>& c,
+// hypothesis matrices theta_a - theta_b for the pairs
+std::vector<Eigen::MatrixXd> pair_hypotheses(
+    const std::vector<std::array<int, 2>>& pairs,
+    const int p);
+// Estimates theta_a - theta_b, -2logLR and optionally confidence intervals
+// for the pairs of pairwise_ibd, shared by the R and standalone front ends.
+// The statistics are computed with one work unit per pair or, with
+// batch_execution(), one lockstep batch per thread over a contiguous block of
+// pairs. Pairs whose test did not converge are warned about.
+struct PAIRWISE_TESTS {
+  Eigen::VectorXd estimate;
+  Eigen::VectorXd statistic;
+  // m x 2, lower and upper limits at cutoff; empty without intervals
+  Eigen::MatrixXd CI;
+};
+PAIRWISE_TESTS pairwise_tests_ibd(
+    const Eigen::Ref<const Eigen::MatrixXd>& x,
+    const Eigen::Ref<const Eigen::MatrixXd>& c,
+    const std::vector<std::array<int, 2>>& pairs,
+    const double cutoff,
+    const bool interval,
+    const int ncores,
+    const int maxit,
+    const double abstol);
+PAIRWISE_TESTS pairwise_tests_ibd(
+    const Eigen::Ref<const Eigen::MatrixXd>& x,
+    const SparseRef& c,
+    const std::vector<std::array<int, 2>>& pairs,
+    const double cutoff,
+    const bool interval,
+    const int ncores,
+    const int maxit,
+    const double abstol);
+PAIRWISE_TESTS pairwise_tests_ibd(
+    const SparseRef& x,
+    const SparseRef& c,
+    const std::vector<std::array<int, 2>>& pairs,
+    const double cutoff,
+    const bool interval,
+    const int ncores,
+    const int maxit,
+    const double abstol);
+// fingerprint of a family of hypothesis matrices
+std::uint64_t fingerprint(const std::vector<Eigen::MatrixXd>& lhs,
+                          std::uint64_t seed);
+// fingerprint of the dimensions and nonzero entries of a matrix, the same for
+// dense and sparse storage
+std::uint64_t fingerprint(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                          std::uint64_t seed = 14695981039346656037ULL);
+std::uint64_t fingerprint(const SparseRef& x,
+                          std::uint64_t seed = 14695981039346656037ULL);
+
+// Bootstrap maximum statistics of the PB and NB methods, one per replicate;
+// the cutoffs below are their quantiles. The arguments are as for cutoff_PB
+// and cutoff_NB. With qmc, the PB draws are QMC_REPLICATES consecutive
+// blocks, each from an independently randomized Sobol sequence.
+const int QMC_REPLICATES = 8;
+Eigen::VectorXd bootstrap_PB(const Eigen::Ref<const Eigen::MatrixXd>& V_hat,
+                             const int n,
+                             const std::vector<Eigen::MatrixXd>& lhs,
+                             const int B,
+                             const std::string& checkpoint = "",
+                             const bool resume = false,
+                             const bool qmc = false);
+Eigen::VectorXd bootstrap_NB(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                             const Eigen::Ref<const Eigen::MatrixXd>& c,
+                             const std::vector<Eigen::MatrixXd>& lhs,
+                             const int B,
+                             const bool approx_lambda,
+                             const int ncores,
+                             const int maxit,
+                             const double abstol,
+                             const std::string& method,
+                             const std::string& checkpoint = "",
+                             const bool resume = false,
+                             const bool screen = false,
+                             const double margin = 0.5);
+// Progress of bootstrap_NB, shared with the thread that polls it. Replicates
+// that have not started when cancelled is set are skipped; a cancelled run
+// returns with those statistics unset.
+struct BOOTSTRAP_PROGRESS {
+  // replicates finished, including those taken from the checkpoint(resumed)
+  std::atomic<int> completed{0};
+  std::atomic<int> resumed{0};
+  std::atomic<bool> cancelled{false};
+};
+// resamples of n rows for B replicates, one column each(0-based), as drawn
+// by bootstrap_NB
+Eigen::ArrayXXi bootstrap_indices(const int n, const int B);
+// as above with the resamples given by the columns of bootstrap_index; draws
+// nothing, so it can run off the R thread
+Eigen::VectorXd bootstrap_NB(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                             const Eigen::Ref<const Eigen::MatrixXd>& c,
+                             const std::vector<Eigen::MatrixXd>& lhs,
+                             const Eigen::ArrayXXi& bootstrap_index,
+                             const bool approx_lambda,
+                             const int ncores,
+                             const int maxit,
+                             const double abstol,
+                             const std::string& method,
+                             const std::string& checkpoint = "",
+                             const bool resume = false,
+                             const bool screen = false,
+                             const double margin = 0.5,
+                             BOOTSTRAP_PROGRESS* progress = nullptr);
+// first of the B statistics in block r when they are split into replicates
+// blocks
+int replicate_begin(const int r, const int B, const int replicates);
+// bootstrap statistics in increasing order within each of replicates blocks;
+// NaN is an error
+Eigen::VectorXd sort_statistics(Eigen::VectorXd statistics,
+                                const int replicates = 1);
+// standard error of a quantile estimate from the spread of the prob-quantiles
+// of the sorted blocks; NaN for a single block
+double replicate_se(const Eigen::Ref<const Eigen::VectorXd>& sorted,
+                    const int replicates,
+                    const double prob);
+// quantile of sorted values, as quantile(type = 7) in R
+double sorted_quantile(const Eigen::Ref<const Eigen::VectorXd>& sorted,
+                       const double prob);
+// factor on the PB cutoff for the blocked bootstrap(correction)
+double correction_PB(const int p, const int n);
+
+// Bootstrap cutoff of pairwise_ibd, shared by the R and standalone front
+// ends: the distribution of the maximum statistic over the pairs by the PB or
+// NB method, its 1 - level quantile and, for several replicates, the
+// standard error of the quantile. The PB cutoff is corrected with correction.
+struct PAIRWISE_BOOTSTRAP {
+  std::string method;
+  int B;
+  double level;
+  bool correction;
+  bool approx_lambda;
+  int ncores;
+  int maxit;
+  double abstol;
+  std::string checkpoint;
+  bool resume;
+  bool screen;
+  double margin;
+  bool qmc;
+};
+struct PAIRWISE_CUTOFF {
+  // sorted within each of replicates blocks
+  Eigen::VectorXd distribution;
+  int replicates = 1;
+  double cutoff;
+  // NaN for a single replicate
+  double se;
+};
+// A nonempty distribution(sorted within each of replicates blocks) is used
+// instead of a new bootstrap; options.method is then the method it was
+// computed with.
+PAIRWISE_CUTOFF pairwise_cutoff(
+    const Eigen::Ref<const Eigen::MatrixXd>& x,
+    const Eigen::Ref<const Eigen::MatrixXd>& c,
+    const std::vector<std::array<int, 2>>& pairs,
+    const PAIRWISE_BOOTSTRAP& options,
+    Eigen::VectorXd distribution = Eigen::VectorXd(),
+    const int replicates = 1);
+PAIRWISE_CUTOFF pairwise_cutoff(
+    const Eigen::Ref<const Eigen::MatrixXd>& x,
+    const SparseRef& c,
+    const std::vector<std::array<int, 2>>& pairs,
+    const PAIRWISE_BOOTSTRAP& options,
+    Eigen::VectorXd distribution = Eigen::VectorXd(),
+    const int replicates = 1);
+PAIRWISE_CUTOFF pairwise_cutoff(
+    const SparseRef& x,
+    const SparseRef& c,
+    const std::vector<std::array<int, 2>>& pairs,
+    const PAIRWISE_BOOTSTRAP& options,
+    Eigen::VectorXd distribution = Eigen::VectorXd(),
+    const int replicates = 1);
+
+// Max-T cutoffs for a family of hypotheses lhs * theta = rhs.
+// V_hat: covariance estimate from cov_ibd, n: number of blocks
+double cutoff_PB(const Eigen::Ref<const Eigen::MatrixXd>& V_hat,
+                 const int n,
+                 const std::vector<Eigen::MatrixXd>& lhs,
+                 const int B,
+                 const double level,
+                 const bool correction,
+                 const std::string& checkpoint = "",
+                 const bool resume = false,
+                 const bool qmc = false);
+// method names the checkpoint records
+double cutoff_NB(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                 const Eigen::Ref<const Eigen::MatrixXd>& c,
+                 const std::vector<Eigen::MatrixXd>& lhs,
+                 const int B,
+                 const double level,
+                 const bool approx_lambda,
+                 const int ncores,
+                 const int maxit,
+                 const double abstol,
+                 const std::string& method,
+                 const std::string& checkpoint = "",
+                 const bool resume = false,
+                 const bool screen = false,
+                 const double margin = 0.5);
+
+double cutoff_pairwise_PB(const Eigen::Ref<const Eigen::MatrixXd>& V_hat,
+                          const int n,
                           const std::vector<std::array<int, 2>>& pairs,
                           const int B,
                           const double level,
-                          const bool correction);
+                          const bool correction,
+                          const std::string& checkpoint = "",
+                          const bool resume = false);
+// Euclidean likelihood statistics n * (L theta_hat)'(L W L')^-1(L theta_hat)
+// at rhs = 0, with W = D^-1 S D^-1 the covariance of sqrt(n) * theta_hat.
+// These track -2logLR closely and cost one Gram matrix per data set.
+Eigen::VectorXd euclidean_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                              const Eigen::Ref<const Eigen::MatrixXd>& c,
+                              const std::vector<Eigen::MatrixXd>& lhs);
+Eigen::VectorXd euclidean_ibd(const DENSE_IBD_MODEL& model,
+                              const std::vector<Eigen::MatrixXd>& lhs);
+// -2logLR for lhs * theta = 0. With a finite bound, the minimization may
+// stop at any value not above bound that bounds -2logLR from above.
+double statistic_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                     const Eigen::Ref<const Eigen::MatrixXd>& c,
+                     const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+                     const bool approx_lambda,
+                     const int maxit,
+                     const double abstol,
+                     const double bound =
+                       -std::numeric_limits<double>::infinity());
+double statistic_ibd(const DENSE_IBD_MODEL& model,
+                     const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+                     const bool approx_lambda,
+                     const int maxit,
+                     const double abstol,
+                     const double bound =
+                       -std::numeric_limits<double>::infinity());
+// Maximum of -2logLR over the hypotheses and an initial maximum. Hypotheses
+// are solved in decreasing order of the Euclidean statistics, each stopped
+// as soon as its objective is certified not to exceed the maximum so far
+// (with exact lambda only; the approximation gives no such certificate).
+double pruned_max_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                      const Eigen::Ref<const Eigen::MatrixXd>& c,
+                      const std::vector<Eigen::MatrixXd>& lhs,
+                      const bool approx_lambda,
+                      const int maxit,
+                      const double abstol,
+                      double maximum =
+                        -std::numeric_limits<double>::infinity());
+double pruned_max_ibd(const DENSE_IBD_MODEL& model,
+                      const std::vector<Eigen::MatrixXd>& lhs,
+                      const bool approx_lambda,
+                      const int maxit,
+                      const double abstol,
+                      double maximum =
+                        -std::numeric_limits<double>::infinity());
+// Maximum of -2logLR over the hypotheses. Exact statistics are computed in
+// decreasing order of the Euclidean statistics until (1 + margin) times the
+// Euclidean statistic falls below the current maximum; solves is the number
+// of exact solves.
+double screened_max_ibd(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                        const Eigen::Ref<const Eigen::MatrixXd>& c,
+                        const std::vector<Eigen::MatrixXd>& lhs,
+                        const double margin,
+                        const bool approx_lambda,
+                        const int maxit,
+                        const double abstol,
+                        int& solves);
+double screened_max_ibd(const DENSE_IBD_MODEL& model,
+                        const std::vector<Eigen::MatrixXd>& lhs,
+                        const double margin,
+                        const bool approx_lambda,
+                        const int maxit,
+                        const double abstol,
+                        int& solves);
 double cutoff_pairwise_NB(const Eigen::Ref<const Eigen::MatrixXd>& x,
                           const Eigen::Ref<const Eigen::MatrixXd>& c,
                           const int B,
                           const double level,
                           const int ncores,
                           const int maxit,
-                          const double abstol);
+                          const double abstol,
+                          const std::string& checkpoint = "",
+                          const bool resume = false,
+                          const bool screen = false,
+                          const double margin = 0.5);
 double cutoff_pairwise_NB_approx(const Eigen::Ref<const Eigen::MatrixXd>& x,
                                  const Eigen::Ref<const Eigen::MatrixXd>& c,
                                  const int B,
                                  const double level,
                                  const int ncores,
                                  const int maxit,
-                                 const double abstol);
+                                 const double abstol,
+                                 const std::string& checkpoint = "",
+                                 const bool resume = false,
+                                 const bool screen = false,
+                                 const double margin = 0.5);
 
 
 // initial value & no approximation
@@ -75,14 +460,34 @@ minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
                   const Eigen::Ref<const Eigen::VectorXd>& rhs,
                   const int maxit = 1000,
                   const double abstol = 1e-8);
-// no approximation
+// sparse incidence matrix
+minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
+                  const Eigen::Ref<const Eigen::MatrixXd>& x,
+                  const SparseRef& c,
+                  const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+                  const Eigen::Ref<const Eigen::VectorXd>& rhs,
+                  const int maxit = 1000,
+                  const double abstol = 1e-8);
+// sparse data and incidence matrix
+minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
+                  const SparseRef& x,
+                  const SparseRef& c,
+                  const Eigen::Ref<const Eigen::MatrixXd>& lhs,
+                  const Eigen::Ref<const Eigen::VectorXd>& rhs,
+                  const int maxit = 1000,
+                  const double abstol = 1e-8);
+// no approximation; the minimization stops early once -logLR is certified
+// not to exceed bound
 minEL test_ibd_EL(const Eigen::Ref<const Eigen::MatrixXd>& x,
                   const Eigen::Ref<const Eigen::MatrixXd>& c,
                   const Eigen::Ref<const Eigen::MatrixXd>& lhs,
                   const Eigen::Ref<const Eigen::VectorXd>& rhs,
                   const int maxit = 1000,
-                  const double abstol = 1e-8);
-// initial value given
+                  const double abstol = 1e-8,
+                  const double bound =
+                    -std::numeric_limits<double>::infinity());
+// initial value given; with approx_lambda, lambda is linearized between
+// iterations and refreshed when it drifts, otherwise solved exactly
 minEL test_ibd_EL(const Eigen::Ref<const Eigen::VectorXd>& theta0,
                   const Eigen::Ref<const Eigen::MatrixXd>& x,
                   const Eigen::Ref<const Eigen::MatrixXd>& c,